@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+
+// the viewer still builds against the TR2 name
+namespace std
+{
+  namespace tr2
+  {
+    namespace sys
+    {
+      using namespace std::filesystem;
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <windows.h>
+
+#include <functional>
+#include <string>
+
+// Enough of the ampp enumerator for EnumeratorStore to compile, it never
+// has rows here.
+namespace etl
+{
+  enum class TraceEventDataItem
+  {
+    TraceIndex,
+    ModuleName,
+    ProcessId,
+    ThreadId,
+    SourceFile,
+    Function,
+    TimeStamp,
+    Message,
+    MAX_ITEM
+  };
+
+  inline TraceEventDataItem &operator++(TraceEventDataItem &item)
+  {
+    item = static_cast<TraceEventDataItem>(static_cast<int>(item) + 1);
+    return item;
+  }
+
+  class TraceEnumerator
+  {
+  public:
+    virtual ~TraceEnumerator() = default;
+    void SetCountCallback(const std::function<void(size_t)> &) {}
+    bool Start() { return false; }
+    void Stop() {}
+    size_t GetItemCount() const { return 0; }
+    void ApplyFilters() {}
+    void RemoveAllItems() {}
+    const std::wstring &GetItemValue(size_t, TraceEventDataItem) const { return empty_; }
+    const wchar_t *GetItemValue(size_t, TraceEventDataItem, size_t *length) const
+    {
+      *length = 0;
+      return L"";
+    }
+    void InjectItem(const FILETIME &, const std::function<std::wstring(TraceEventDataItem)> &) {}
+  private:
+    std::wstring empty_;
+  };
+}
@@ -0,0 +1,61 @@
+#include <windows.h>
+
+namespace
+{
+
+// FILETIME counts 100 ns since 1601-01-01, days relative to 1970-01-01 are
+// converted with the civil calendar algorithms of Howard Hinnant
+const int64_t ticksPerMs = 10000;
+const int64_t msPerDay = 86400000;
+const int64_t daysFrom1601To1970 = 134774;
+
+int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+} // private namespace
+
+BOOL FileTimeToSystemTime(const FILETIME *ft, SYSTEMTIME *st)
+{
+  const uint64_t ticks = (static_cast<uint64_t>(ft->dwHighDateTime) << 32) | ft->dwLowDateTime;
+  const int64_t ms = static_cast<int64_t>(ticks / ticksPerMs);
+  const int64_t z = ms / msPerDay - daysFrom1601To1970 + 719468;
+  const int64_t msOfDay = ms % msPerDay;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+  st->wYear = static_cast<WORD>(static_cast<int64_t>(yoe) + era * 400 + (m <= 2));
+  st->wMonth = static_cast<WORD>(m);
+  st->wDay = static_cast<WORD>(doy - (153 * mp + 2) / 5 + 1);
+  // 1601-01-01 was a Monday
+  st->wDayOfWeek = static_cast<WORD>((ms / msPerDay + 1) % 7);
+  st->wHour = static_cast<WORD>(msOfDay / 3600000);
+  st->wMinute = static_cast<WORD>(msOfDay / 60000 % 60);
+  st->wSecond = static_cast<WORD>(msOfDay / 1000 % 60);
+  st->wMilliseconds = static_cast<WORD>(msOfDay % 1000);
+  return TRUE;
+}
+
+BOOL SystemTimeToFileTime(const SYSTEMTIME *st, FILETIME *ft)
+{
+  if (st->wYear < 1601 || st->wMonth < 1 || st->wMonth > 12 || st->wDay < 1 || st->wDay > 31 ||
+      st->wHour > 23 || st->wMinute > 59 || st->wSecond > 59 || st->wMilliseconds > 999)
+  {
+    return FALSE;
+  }
+  const int64_t days = DaysFromCivil(st->wYear, st->wMonth, st->wDay) + daysFrom1601To1970;
+  const int64_t ms = days * msPerDay + st->wHour * 3600000 + st->wMinute * 60000 + st->wSecond * 1000 + st->wMilliseconds;
+  const uint64_t ticks = static_cast<uint64_t>(ms) * ticksPerMs;
+  ft->dwLowDateTime = static_cast<DWORD>(ticks);
+  ft->dwHighDateTime = static_cast<DWORD>(ticks >> 32);
+  return TRUE;
+}
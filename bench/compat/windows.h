@@ -0,0 +1,55 @@
+#pragma once
+
+// The part of the Windows API the stores use, for building them on other
+// platforms. Only for the benchmarks, the viewer builds with etrace.sln.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef int BOOL;
+typedef uint32_t COLORREF;
+typedef unsigned int UINT;
+
+#define TRUE 1
+#define FALSE 0
+
+struct FILETIME
+{
+  DWORD dwLowDateTime;
+  DWORD dwHighDateTime;
+};
+
+struct SYSTEMTIME
+{
+  WORD wYear;
+  WORD wMonth;
+  WORD wDayOfWeek;
+  WORD wDay;
+  WORD wHour;
+  WORD wMinute;
+  WORD wSecond;
+  WORD wMilliseconds;
+};
+
+union ULARGE_INTEGER
+{
+  struct
+  {
+    DWORD LowPart;
+    DWORD HighPart;
+  };
+  unsigned long long QuadPart;
+};
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#define __max(a, b) (((a) > (b)) ? (a) : (b))
+#define __min(a, b) (((a) < (b)) ? (a) : (b))
+
+BOOL FileTimeToSystemTime(const FILETIME *ft, SYSTEMTIME *st);
+BOOL SystemTimeToFileTime(const SYSTEMTIME *st, FILETIME *ft);
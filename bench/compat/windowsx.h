@@ -0,0 +1,3 @@
+#pragma once
+
+// nothing the stores need
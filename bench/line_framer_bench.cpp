@@ -0,0 +1,169 @@
+#include "line_framer.h"
+
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <locale>
+#include <string>
+#include <vector>
+
+// Feeds a canned serial capture, repeated to the given size, through the
+// COM reader's framing in reads of 2000 bytes: the wstring_convert and split
+// path StartCom used before against LineFramer widening each line once into
+// a reused batch buffer. Both have to hand out the same lines.
+// Usage: line_framer_bench capture [megabytes], 80 MB by default.
+
+namespace
+{
+  const size_t readSize = 2000;
+
+  // counts the lines handed to the batch, hashes them in the checking run
+  struct Sink
+  {
+    bool hashing = false;
+    size_t lines = 0;
+    size_t chars = 0;
+    unsigned long long hash = 14695981039346656037ull;
+
+    void Add(const wchar_t *line, size_t length)
+    {
+      ++lines;
+      chars += length;
+      for (size_t i = 0; hashing && i < length; ++i)
+      {
+        hash = (hash ^ static_cast<unsigned>(line[i])) * 1099511628211ull;
+      }
+      hash = (hash ^ '\n') * 1099511628211ull;
+    }
+  };
+
+  std::vector<std::wstring> Split(const std::wstring &str, wchar_t delimiter)
+  {
+    std::vector<std::wstring> parts;
+    size_t begin = 0;
+    for (size_t pos; (pos = str.find(delimiter, begin)) != std::wstring::npos; begin = pos + 1)
+    {
+      parts.push_back(str.substr(begin, pos - begin));
+    }
+    parts.push_back(str.substr(begin));
+    return parts;
+  }
+
+  // the ConsumeData state of LogContext::StartCom, as it was
+  Sink ConvertAndSplit(const std::string &data, bool hashing)
+  {
+    Sink sink;
+    sink.hashing = hashing;
+    char tmp[readSize];
+    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> converter;
+    std::wstring keepString;
+    for (size_t pos = 0; pos < data.size(); pos += readSize)
+    {
+      const size_t bytesRead = std::min(readSize, data.size() - pos);
+      std::copy_n(data.data() + pos, bytesRead, tmp);
+      for (size_t i = 0; i < bytesRead; ++i)
+      {
+        if ((tmp[i] & 0x80) != 0)
+        {
+          tmp[i] = '?';
+        }
+      }
+      std::wstring str = keepString;
+      str += converter.from_bytes(tmp, tmp + bytesRead);
+      keepString.clear();
+      auto sv = Split(str, L'\n');
+      if (str.length() > 0 && str.back() != L'\n')
+      {
+        keepString = sv.back();
+        sv.pop_back();
+      }
+      for (auto &&s : sv)
+      {
+        while (!s.empty() && iswspace(s.back()))
+        {
+          s.pop_back();
+        }
+        if (s.length() > 0)
+        {
+          sink.Add(s.c_str(), s.length());
+        }
+      }
+    }
+    return sink;
+  }
+
+  // LineFramer with TextBatch::SetAsciiValue widening into the batch text
+  Sink Framer(const std::string &data, bool hashing)
+  {
+    Sink sink;
+    sink.hashing = hashing;
+    LineFramer framer(readSize);
+    std::wstring text;
+    const auto addLine = [&sink, &text](const char *line, size_t length)
+    {
+      const size_t offset = text.length();
+      text.resize(offset + length);
+      wchar_t *out = &text[offset];
+      for (size_t i = 0; i < length; ++i)
+      {
+        const auto c = static_cast<unsigned char>(line[i]);
+        out[i] = c < 0x80 ? c : L'?';
+      }
+      sink.Add(out, length);
+    };
+    for (size_t pos = 0; pos < data.size(); pos += readSize)
+    {
+      const size_t bytesRead = std::min(readSize, data.size() - pos);
+      std::copy_n(data.data() + pos, bytesRead, framer.ReadBuffer());
+      text.clear();
+      framer.Consume(bytesRead, addLine);
+    }
+    return sink;
+  }
+
+  double Ms(std::chrono::steady_clock::time_point since)
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+  }
+} // private namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: line_framer_bench capture [megabytes]\n");
+    return 2;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  const std::string capture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (capture.empty())
+  {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 2;
+  }
+  const size_t size = (argc > 2 ? strtoul(argv[2], nullptr, 10) : 80) << 20;
+  std::string data;
+  data.reserve(size + capture.size());
+  while (data.size() < size)
+  {
+    // the capture ends without a line end, the next copy continues it
+    data += capture;
+  }
+  auto start = std::chrono::steady_clock::now();
+  ConvertAndSplit(data, false);
+  const double beforeMs = Ms(start);
+  start = std::chrono::steady_clock::now();
+  Framer(data, false);
+  const double afterMs = Ms(start);
+  const Sink before = ConvertAndSplit(data, true);
+  const Sink after = Framer(data, true);
+  const bool same = before.lines == after.lines && before.chars == after.chars && before.hash == after.hash;
+  printf("%zu MB, %zu lines\n", data.size() >> 20, after.lines);
+  printf("convert and split %8.1f ms %8.1f MB/s\n", beforeMs, data.size() / beforeMs / 1000);
+  printf("line framer       %8.1f ms %8.1f MB/s\n", afterMs, data.size() / afterMs / 1000);
+  printf("lines %s\n", same ? "identical" : "DIFFER");
+  return same ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "row_state.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// Per row view state for ten million rows by default: the RowStateTable
+// against a heap object per row reached through a pointer per row, the way
+// the rows kept their RowContext before.
+// Usage: row_state_bench [rows]
+
+namespace
+{
+  struct RowContext
+  {
+    float colorFade = 1.0f;
+    int lastFilterCount = -1;
+    int groupId = 0;
+  };
+
+  // resident bytes of the process, 0 where /proc is missing
+  size_t ResidentBytes()
+  {
+    size_t pages = 0;
+    size_t resident = 0;
+    if (FILE *fh = fopen("/proc/self/statm", "r"))
+    {
+      if (fscanf(fh, "%zu %zu", &pages, &resident) != 2)
+      {
+        resident = 0;
+      }
+      fclose(fh);
+    }
+    return resident * 4096;
+  }
+
+  double Ms(std::chrono::steady_clock::time_point since)
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+  }
+
+  void Report(const char *name, size_t rowCount, size_t bytes, double writeMs, double readMs, long long check)
+  {
+    printf("%-16s %8.1f bytes/row %8.1f ms write %8.1f ms read %6.1f Mrows/s (%lld)\n", name,
+      static_cast<double>(bytes) / rowCount, writeMs, readMs, rowCount / readMs / 1000, check);
+  }
+} // private namespace
+
+int main(int argc, char **argv)
+{
+  const size_t rowCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+  printf("%zu rows\n", rowCount);
+  long long tableSum = 0;
+  {
+    const size_t before = ResidentBytes();
+    auto start = std::chrono::steady_clock::now();
+    RowStateTable table;
+    for (size_t row = 0; row < rowCount; ++row)
+    {
+      table.SetFade(row, row % 3 ? 1.0f : 0.37f, 1);
+      table.SetGroupId(row, static_cast<int>(row % 17));
+    }
+    const double writeMs = Ms(start);
+    const size_t bytes = ResidentBytes() - before;
+    start = std::chrono::steady_clock::now();
+    for (size_t row = 0; row < rowCount; ++row)
+    {
+      tableSum += table.GroupId(row) + table.LastFilterCount(row) + (table.ColorFade(row) < 1.0f);
+    }
+    Report("RowStateTable", rowCount, bytes, writeMs, Ms(start), tableSum);
+  }
+  long long objectSum = 0;
+  {
+    const size_t before = ResidentBytes();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<RowContext>> rowInfo;
+    std::vector<void *> metadata;
+    for (size_t row = 0; row < rowCount; ++row)
+    {
+      rowInfo.push_back(std::make_unique<RowContext>());
+      metadata.push_back(rowInfo.back().get());
+      auto rc = static_cast<RowContext *>(metadata[row]);
+      rc->colorFade = row % 3 ? 1.0f : 0.37f;
+      rc->lastFilterCount = 1;
+      rc->groupId = static_cast<int>(row % 17);
+    }
+    const double writeMs = Ms(start);
+    const size_t bytes = ResidentBytes() - before;
+    start = std::chrono::steady_clock::now();
+    for (size_t row = 0; row < rowCount; ++row)
+    {
+      auto rc = static_cast<const RowContext *>(metadata[row]);
+      objectSum += rc->groupId + rc->lastFilterCount + (rc->colorFade < 1.0f);
+    }
+    Report("object per row", rowCount, bytes, writeMs, Ms(start), objectSum);
+  }
+  return tableSum == objectSum ? 0 : 1;
+}
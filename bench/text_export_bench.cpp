@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "text_log_store.h"
+#include "text_exporter.h"
+
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <locale>
+#include <thread>
+
+// Text export of an eager and a lazy TextLogStore, the per line path the
+// viewer used before TextExporter against TextExporter. Both outputs have
+// to be identical.
+// Usage: text_export_bench [rows [directory]], two million rows in the
+// temp directory by default.
+
+namespace
+{
+  const wchar_t *columnNames[] = { L"ID", L"LOG", L"PROCESS", L"THREAD", L"FILE", L"FUNCTION", L"TIMESTAMP", L"MESSAGE" };
+
+  void WriteLog(const fs::path &path, size_t rowCount)
+  {
+    static const char *modules[] = { "net", "disk", "ui", "core" };
+    static const char *functions[] = { "Connect", "Flush", "OnPaint", "Dispatch", "Retry" };
+    FILE *fh = fopen(path.string().c_str(), "wb");
+    fputs("ID\tLOG\tPROCESS\tTHREAD\tFILE\tFUNCTION\tTIMESTAMP\tMESSAGE\r\n", fh);
+    for (size_t n = 0; n < rowCount; ++n)
+    {
+      // some messages are not ASCII, some are empty
+      fprintf(fh, "%zu\t%s\t%u\t%u\t%s.cpp\t%s\t2024-03-%02u 12:%02u:%02u.%03u\t%s %zu%s\r\n", n, modules[n % 4],
+        1000 + static_cast<unsigned>(n % 7), 2000 + static_cast<unsigned>(n % 31), modules[n % 4], functions[n % 5],
+        static_cast<unsigned>(1 + n / 100000 % 28), static_cast<unsigned>(n / 60 % 60), static_cast<unsigned>(n % 60),
+        static_cast<unsigned>(n % 1000), n % 11 == 0 ? "Größe überschritten" : "request handled in", n % 977,
+        n % 13 == 0 ? " ms" : " ms, queue length 12, retries 0");
+    }
+    fclose(fh);
+  }
+
+  std::wstring &TrimR(std::wstring &s)
+  {
+    while (!s.empty() && iswspace(s.back()))
+    {
+      s.pop_back();
+    }
+    return s;
+  }
+
+  // LogContext::ExtractTextLines with the wstring_convert output of the
+  // export, as it was
+  bool PerLineExport(const LogStore &store, size_t rowCount, const fs::path &path)
+  {
+    FILE *fh = fopen(path.string().c_str(), "wb");
+    if (!fh)
+    {
+      return false;
+    }
+    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> converter;
+    const auto output = [&converter, fh](const std::wstring &txt)
+    {
+      std::string tmp = converter.to_bytes(txt);
+      return fwrite(tmp.c_str(), 1, tmp.length(), fh) == tmp.length();
+    };
+    std::wstring header;
+    for (auto name : columnNames)
+    {
+      if (!header.empty())
+      {
+        header += L'\t';
+      }
+      header += name;
+    }
+    output(TrimR(header) += L"\r\n");
+    bool rv = true;
+    for (size_t row = 0; row < rowCount && rv; ++row)
+    {
+      std::wstring txt;
+      for (int c = 0; c < _countof(columnNames); ++c)
+      {
+        if (!txt.empty())
+        {
+          txt += L'\t';
+        }
+        txt += store.GetItemValue(row, static_cast<etl::TraceEventDataItem>(c));
+      }
+      rv = output(TrimR(txt) += L"\r\n");
+    }
+    fclose(fh);
+    return rv;
+  }
+
+  bool ExporterExport(const LogStore &store, size_t rowCount, const fs::path &path)
+  {
+    std::vector<ExportField> fields;
+    for (int c = 0; c < _countof(columnNames); ++c)
+    {
+      fields.push_back({ columnNames[c], static_cast<etl::TraceEventDataItem>(c), ExportField::Type::Text });
+    }
+    TextExporter exporter(store, fields);
+    exporter.IncludeHeader(true);
+    ExportRows rows;
+    rows.all = true;
+    rows.rowCount = rowCount;
+    FILE *fh = fopen(path.string().c_str(), "wb");
+    if (!fh)
+    {
+      return false;
+    }
+    const bool rv = exporter.Write(fh, rows);
+    fclose(fh);
+    return rv;
+  }
+
+  bool SameFile(const fs::path &a, const fs::path &b)
+  {
+    std::ifstream fa(a, std::ios::binary);
+    std::ifstream fb(b, std::ios::binary);
+    return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+      std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+  }
+
+  double Ms(std::chrono::steady_clock::time_point since)
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+  }
+} // private namespace
+
+int main(int argc, char **argv)
+{
+  const size_t rowCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+  const fs::path dir = argc > 2 ? fs::path(argv[2]) : fs::temp_directory_path();
+  const auto logPath = dir / "etrace_export_bench.log";
+  const auto perLinePath = dir / "etrace_export_bench.perline.txt";
+  const auto exporterPath = dir / "etrace_export_bench.exporter.txt";
+  WriteLog(logPath, rowCount);
+  TextLogStore::Columns columns;
+  for (int c = 0; c < _countof(columnNames); ++c)
+  {
+    columns.emplace_back(columnNames[c], static_cast<etl::TraceEventDataItem>(c));
+  }
+  printf("%zu rows, %u hardware threads\n", rowCount, std::thread::hardware_concurrency());
+  bool same = true;
+  for (const bool lazy : { false, true })
+  {
+    std::vector<etl::TraceEventDataItem> codedItems;
+    for (int c = 1; lazy && c <= 5; ++c)
+    {
+      codedItems.push_back(static_cast<etl::TraceEventDataItem>(c));
+    }
+    TextLogStore store(logPath, columns, lazy, codedItems);
+    store.Start();
+    while (store.GetItemCount() < rowCount)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto start = std::chrono::steady_clock::now();
+    const bool perLine = PerLineExport(store, rowCount, perLinePath);
+    const double perLineMs = Ms(start);
+    start = std::chrono::steady_clock::now();
+    const bool exported = ExporterExport(store, rowCount, exporterPath);
+    const double exporterMs = Ms(start);
+    const bool identical = perLine && exported && SameFile(perLinePath, exporterPath);
+    same &= identical;
+    printf("%-5s store: per line %.0f ms, exporter %.0f ms, %.1fx, output %s\n", lazy ? "lazy" : "eager",
+      perLineMs, exporterMs, perLineMs / exporterMs, identical ? "identical" : "DIFFERS");
+  }
+  std::error_code ec;
+  for (auto &&path : { logPath, perLinePath, exporterPath, fs::path(logPath.string() + ".etidx") })
+  {
+    fs::remove(path, ec);
+  }
+  return same ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#include "cobs.h"
+
+bool CobsDecode(const uint8_t *in, size_t length, uint8_t *out, size_t *outLength)
+{
+  size_t i = 0;
+  size_t o = 0;
+  while (i < length)
+  {
+    // code n: n - 1 data bytes follow, then a zero unless n is 0xFF or the
+    // block ends the record
+    const uint8_t code = in[i++];
+    if (code == 0 || code - 1u > length - i)
+    {
+      return false;
+    }
+    for (uint8_t n = 1; n < code; ++n)
+    {
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < length)
+    {
+      out[o++] = 0;
+    }
+  }
+  *outLength = o;
+  return true;
+}
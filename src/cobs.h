@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Consistent Overhead Byte Stuffing, the framing of the binary serial
+// protocol: a record is encoded so that it holds no zero byte and a zero
+// byte ends it on the wire. Decoding never grows the data, in and out may
+// be the same buffer. False if the input is not valid COBS.
+bool CobsDecode(const uint8_t *in, size_t length, uint8_t *out, size_t *outLength);
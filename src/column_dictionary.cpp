@@ -0,0 +1,129 @@
+#include "column_dictionary.h"
+
+ColumnDictionary::ColumnDictionary()
+  : rows_(new std::atomic<uint32_t *>[MaxRowChunks])
+  , entries_(new std::atomic<Entry *>[MaxEntryChunks])
+  , codedRows_(0)
+  , size_(0)
+{
+  for (size_t i = 0; i < MaxRowChunks; ++i)
+  {
+    rows_[i].store(nullptr, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < MaxEntryChunks; ++i)
+  {
+    entries_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+ColumnDictionary::~ColumnDictionary()
+{
+  Clear();
+}
+
+bool ColumnDictionary::Append(size_t row, const std::wstring &value, uint32_t *code, bool *added)
+{
+  if (row != codedRows_.load(std::memory_order_relaxed) || row / RowChunk >= MaxRowChunks)
+  {
+    return false;
+  }
+  return Intern(value, code, added) && AppendCode(row, *code);
+}
+
+bool ColumnDictionary::Intern(const std::wstring &value, uint32_t *code, bool *added)
+{
+  *added = false;
+  auto it = index_.find(value);
+  if (it != index_.end())
+  {
+    *code = it->second;
+  }
+  else
+  {
+    const size_t size = size_.load(std::memory_order_relaxed);
+    if (size / EntryChunk >= MaxEntryChunks)
+    {
+      return false;
+    }
+    auto &chunk = entries_[size / EntryChunk];
+    if (!chunk.load(std::memory_order_relaxed))
+    {
+      chunk.store(new Entry[EntryChunk], std::memory_order_release);
+    }
+    auto &entry = chunk.load(std::memory_order_relaxed)[size % EntryChunk];
+    entry.value = value;
+    entry.count.store(0, std::memory_order_relaxed);
+    *code = static_cast<uint32_t>(size);
+    *added = true;
+    index_.emplace(value, *code);
+    size_.store(size + 1, std::memory_order_release);
+  }
+  return true;
+}
+
+bool ColumnDictionary::AppendCode(size_t row, uint32_t code)
+{
+  if (row != codedRows_.load(std::memory_order_relaxed) || row / RowChunk >= MaxRowChunks)
+  {
+    return false;
+  }
+  EntryAt(code).count.fetch_add(1, std::memory_order_relaxed);
+  auto &rowChunk = rows_[row / RowChunk];
+  if (!rowChunk.load(std::memory_order_relaxed))
+  {
+    rowChunk.store(new uint32_t[RowChunk], std::memory_order_release);
+  }
+  rowChunk.load(std::memory_order_relaxed)[row % RowChunk] = code;
+  codedRows_.store(row + 1, std::memory_order_release);
+  return true;
+}
+
+void ColumnDictionary::Clear()
+{
+  for (size_t i = 0; i < MaxRowChunks; ++i)
+  {
+    delete[] rows_[i].exchange(nullptr);
+  }
+  for (size_t i = 0; i < MaxEntryChunks; ++i)
+  {
+    delete[] entries_[i].exchange(nullptr);
+  }
+  index_.clear();
+  codedRows_ = 0;
+  size_ = 0;
+}
+
+size_t ColumnDictionary::CodedRows() const
+{
+  return codedRows_.load(std::memory_order_acquire);
+}
+
+bool ColumnDictionary::Code(size_t row, uint32_t *code) const
+{
+  if (row >= codedRows_.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  *code = rows_[row / RowChunk].load(std::memory_order_relaxed)[row % RowChunk];
+  return true;
+}
+
+size_t ColumnDictionary::Size() const
+{
+  return size_.load(std::memory_order_acquire);
+}
+
+ColumnDictionary::Entry &ColumnDictionary::EntryAt(uint32_t code) const
+{
+  return entries_[code / EntryChunk].load(std::memory_order_acquire)[code % EntryChunk];
+}
+
+const std::wstring &ColumnDictionary::Value(uint32_t code) const
+{
+  return EntryAt(code).value;
+}
+
+size_t ColumnDictionary::Count(uint32_t code) const
+{
+  return EntryAt(code).count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Dictionary encoding of a column whose values repeat a lot. Every distinct
+// value gets a dense code in order of first appearance and every row keeps
+// the code of its value. Rows are appended by a single writer, readers on
+// other threads may look at any row below CodedRows and at any code they got
+// from such a row.
+class ColumnDictionary
+{
+public:
+  ColumnDictionary();
+  ~ColumnDictionary();
+  ColumnDictionary(const ColumnDictionary &) = delete;
+  ColumnDictionary &operator=(const ColumnDictionary &) = delete;
+  // Row has to be CodedRows(), returns false once the dictionary is full.
+  bool Append(size_t row, const std::wstring &value, uint32_t *code, bool *added);
+  // Code of the value without a row, for a writer that codes rows in bulk.
+  bool Intern(const std::wstring &value, uint32_t *code, bool *added);
+  // Row has to be CodedRows(), code one that Intern returned.
+  bool AppendCode(size_t row, uint32_t code);
+  // Nobody else may access the dictionary meanwhile.
+  void Clear();
+  size_t CodedRows() const;
+  bool Code(size_t row, uint32_t *code) const;
+  // Number of distinct values.
+  size_t Size() const;
+  const std::wstring &Value(uint32_t code) const;
+  // Number of rows having the value.
+  size_t Count(uint32_t code) const;
+private:
+  struct Entry
+  {
+    std::wstring value;
+    std::atomic<size_t> count;
+  };
+  static const size_t RowChunk = 0x10000;
+  static const size_t MaxRowChunks = 0x4000;
+  static const size_t EntryChunk = 0x400;
+  static const size_t MaxEntryChunks = 0x4000;
+  Entry &EntryAt(uint32_t code) const;
+private:
+  std::unique_ptr<std::atomic<uint32_t *>[]> rows_;
+  std::unique_ptr<std::atomic<Entry *>[]> entries_;
+  std::atomic<size_t> codedRows_;
+  std::atomic<size_t> size_;
+  // writer only
+  std::unordered_map<std::wstring, uint32_t> index_;
+};
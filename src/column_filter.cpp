@@ -0,0 +1,116 @@
+#include "column_filter.h"
+#include "regex_syntax.h"
+
+#include <regex>
+
+namespace
+{
+
+bool ValidRegEx(const std::wstring &txt)
+{
+  if(txt.empty())
+  {
+    return false;
+  }
+  wchar_t last = 0;
+  int bsCount = 0;
+  int brackets = 0;
+  for(auto ch : txt)
+  {
+    if((bsCount & 1) == 1 && last == L'\\' && ch >= L'0' && ch <= L'9')
+    {
+      return false;
+    }
+    if(ch == L'\\')
+    {
+      ++bsCount;
+    }
+    else
+    {
+      bsCount = 0;
+      if ((bsCount & 1) == 0 ||last != L'\\')
+      {
+        if (ch == L'[')
+        {
+          ++brackets;
+        }
+        if (ch == L']')
+        {
+          --brackets;
+        }
+      }
+    }
+    last = ch;
+  }
+  return (bsCount & 1) != 1 && brackets == 0;
+}
+
+} // private namespace
+
+ColumnFilter::ColumnFilter(const std::wstring &text)
+  : text_(text)
+{
+  if (ValidRegEx(text_))
+  {
+    try
+    {
+      matcher_ = CompileRegexMatcher(text_);
+      auto root = ParseRegex(text_);
+      if (root && !ExactLiteral(*root, &literal_))
+      {
+        literal_.clear();
+      }
+    }
+    catch (const std::regex_error &)
+    {
+      // ValidRegEx only weeds out the most common half-typed patterns,
+      // anything else std::regex refuses is treated as no filter at all
+      matcher_.reset();
+    }
+  }
+}
+
+const std::wstring &ColumnFilter::Text() const
+{
+  return text_;
+}
+
+bool ColumnFilter::IsActive() const
+{
+  return matcher_ != nullptr;
+}
+
+bool ColumnFilter::IsMatch(const std::wstring &value, bool default_result) const
+{
+  if (!matcher_)
+  {
+    return default_result;
+  }
+  return matcher_->Search(value.data(), value.data() + value.length());
+}
+
+bool ColumnFilter::IsEquivalent(const ColumnFilter &other) const
+{
+  if (!IsActive() || !other.IsActive())
+  {
+    return IsActive() == other.IsActive();
+  }
+  return text_ == other.text_;
+}
+
+bool ColumnFilter::Narrows(const ColumnFilter &previous) const
+{
+  if (!previous.IsActive())
+  {
+    return true;
+  }
+  if (!IsActive())
+  {
+    return false;
+  }
+  if (text_ == previous.text_)
+  {
+    return true;
+  }
+  return !literal_.empty() && !previous.literal_.empty() && literal_.find(previous.literal_) != std::wstring::npos;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "regex_matcher.h"
+
+// Immutable, pre-compiled form of the text typed into a column filter box.
+// A new instance is built every time the filter text changes and is then
+// shared read-only between the UI thread and any thread evaluating rows.
+class ColumnFilter
+{
+public:
+  explicit ColumnFilter(const std::wstring &text = L"");
+  const std::wstring &Text() const;
+  bool IsActive() const;
+  bool IsMatch(const std::wstring &value, bool default_result = true) const;
+  // true if both filters accept exactly the same values
+  bool IsEquivalent(const ColumnFilter &other) const;
+  // true if every value accepted by this filter is accepted by previous too,
+  // e.g. when a literal has been extended by typing more characters
+  bool Narrows(const ColumnFilter &previous) const;
+private:
+  std::wstring text_;
+  // folded text when the pattern is nothing but a literal
+  std::wstring literal_;
+  std::unique_ptr<RegexMatcher> matcher_;
+};
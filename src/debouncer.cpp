@@ -0,0 +1,44 @@
+#include "debouncer.h"
+
+Debouncer::Debouncer(Clock::duration delay, const TimeSource &now)
+  : delay_(delay)
+  , now_(now)
+  , pending_(false)
+{
+}
+
+void Debouncer::Request()
+{
+  pending_ = true;
+  last_ = now_();
+}
+
+void Debouncer::Cancel()
+{
+  pending_ = false;
+}
+
+bool Debouncer::IsPending() const
+{
+  return pending_;
+}
+
+Debouncer::Clock::duration Debouncer::Remaining() const
+{
+  if (!pending_)
+  {
+    return Clock::duration::zero();
+  }
+  const auto elapsed = now_() - last_;
+  return elapsed >= delay_ ? Clock::duration::zero() : delay_ - elapsed;
+}
+
+bool Debouncer::Fire()
+{
+  if (!pending_ || now_() - last_ < delay_)
+  {
+    return false;
+  }
+  pending_ = false;
+  return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+// Coalesces a burst of requests into one, due once no new request has come
+// in for the delay. Nothing runs by itself: the owner polls Fire, e.g. from
+// a timer, and time is read through a replaceable source so the behaviour
+// can be driven by hand.
+class Debouncer
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  using TimeSource = std::function<Clock::time_point()>;
+  explicit Debouncer(Clock::duration delay, const TimeSource &now = &Clock::now);
+  void Request();
+  void Cancel();
+  bool IsPending() const;
+  // Time left until the pending request is due, zero once it is.
+  Clock::duration Remaining() const;
+  // True once per burst, when the delay has passed since its last request.
+  bool Fire();
+private:
+  Clock::duration delay_;
+  TimeSource now_;
+  bool pending_;
+  Clock::time_point last_;
+};
@@ -138,6 +138,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
   cmdLineMap[L"pdb"];
   auto &comVec = cmdLineMap[L"com"];
   auto &baudVec = cmdLineMap[L"baud"];
+  auto &comFormatsVec = cmdLineMap[L"comformats"];
   auto &sessionNameVec = cmdLineMap[L"live"];
   auto &logVec = cmdLineMap[L"log"];
   ParseCommandLine(lpCmdLine, cmdLineMap);
@@ -159,6 +160,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
   {
     context.SetBaudRate(std::stoi(baudVec[0]));
   }
+  if (!comFormatsVec.empty())
+  {
+    context.SetComFormats(comFormatsVec.front());
+  }
   if(!sessionNameVec.empty())
   {
     context.InitializeLiveSession(sessionNameVec.front().empty() ? etl::NewGuidAsString() : sessionNameVec.front());
@@ -322,7 +327,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case NM_CUSTOMDRAW:
     {
       auto lvd = reinterpret_cast<NMLVCUSTOMDRAW *>(lParam);
-      if(lvd->nmcd.dwDrawStage == CDDS_ITEMPREPAINT)
+      if(lvd->nmcd.dwDrawStage == CDDS_PREPAINT)
+      {
+        context->UpdateVisibleFades();
+      }
+      else if(lvd->nmcd.dwDrawStage == CDDS_ITEMPREPAINT)
       {
         context->SetItemColors(lvd);
       }
@@ -358,7 +367,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
       case CBN_EDITCHANGE:
       case CBN_SELCHANGE:
         context->UpdateFilterText(wmId);
-        context->ApplyFilters();
+        context->ScheduleFilters();
         break;
       }
     }
@@ -396,6 +405,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
       case ID_FILE_EXPORT:
         context->ExportFromDialogAll();
         break;
+      case ID_FILE_EXPORTFILTERED:
+        context->ExportFromDialogFiltered();
+        break;
+      case ID_FILE_EXPORTTIMERANGE:
+        context->ExportFromDialogTimeRange();
+        break;
       case ID_FILE_EXPORTSELECTED:
         context->ExportFromDialogSelected();
         break;
@@ -408,6 +423,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
       case ID_EDIT_FINDPREVIOUS:
         context->GotoPreviousMatch();
         break;
+      case ID_VIEW_HIDENONMATCHING:
+        context->ToggleHideNonMatching();
+        break;
       case ID_EDIT_CLEAR:
         context->EndTrace();
         context->ClearTraceUnsafe();
@@ -432,6 +450,29 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     EndPaint(hWnd, &ps);
   }
   break;
+  case WM_FILTERPASSDONE:
+    reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->FilterPassDone(static_cast<int>(wParam));
+    break;
+  case WM_FILTERPROGRESS:
+    reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->FilterProgress(static_cast<int>(wParam), static_cast<int>(lParam));
+    break;
+  case WM_JOBPROGRESS:
+    reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->JobProgress(static_cast<int>(wParam));
+    break;
+  case WM_JOBDONE:
+    reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->JobDone(static_cast<int>(wParam), lParam != 0);
+    break;
+  case WM_TIMER:
+    switch (wParam)
+    {
+    case IDT_FILTERDEBOUNCE:
+      reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->FilterTimer();
+      break;
+    case IDT_VIEWREFRESH:
+      reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->RefreshView();
+      break;
+    }
+    break;
   case WM_SIZE:
     reinterpret_cast<LogContext *>(GetWindowLongPtr(hWnd, GWLP_USERDATA))->RepositionControls();
     break;
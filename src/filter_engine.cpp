@@ -0,0 +1,347 @@
+#include "filter_engine.h"
+
+namespace
+{
+
+// multiple of 64 so that chunks never share a bitmap word
+const size_t ChunkRows = 0x4000;
+const size_t CancelCheckWords = 0x10;
+// finished bitmaps kept for backspacing and narrowing
+const size_t HistorySize = 8;
+
+bool IsEquivalent(const FilterSet &a, const FilterSet &b)
+{
+  if (a.size() != b.size())
+  {
+    return false;
+  }
+  for (size_t c = 0; c < a.size(); ++c)
+  {
+    if (!a[c]->IsEquivalent(*b[c]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Narrows(const FilterSet &filters, const FilterSet &previous)
+{
+  if (filters.size() != previous.size())
+  {
+    return false;
+  }
+  for (size_t c = 0; c < filters.size(); ++c)
+  {
+    if (!filters[c]->Narrows(*previous[c]))
+    {
+      return false;
+    }
+    // a filter that was not active could not match, rows without a match
+    // before could have one now
+    if (filters[c]->IsActive() && !previous[c]->IsActive())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CollectRows(const std::vector<uint64_t> &bitmap, std::vector<size_t> *rows)
+{
+  rows->clear();
+  for (size_t w = 0; w < bitmap.size(); ++w)
+  {
+    for (uint64_t word = bitmap[w]; word != 0; word &= word - 1)
+    {
+      size_t bit = 0;
+      while ((word >> bit & 1) == 0)
+      {
+        ++bit;
+      }
+      rows->push_back(w * 64 + bit);
+    }
+  }
+}
+
+uint64_t LowBits(size_t count)
+{
+  return count >= 64 ? ~0ull : (1ull << count) - 1;
+}
+
+} // private namespace
+
+struct FilterEngine::Pass
+{
+  int generation;
+  FilterSet filters;
+  std::unique_ptr<FilterEvaluator> evaluator;
+  size_t rowCount;
+  std::vector<uint64_t> visible;
+  std::vector<uint64_t> matches;
+  std::unique_ptr<std::atomic<bool>[]> chunkDone;
+  size_t chunkCount;
+  std::atomic<size_t> remaining;
+  std::atomic<bool> cancelled;
+  // finished pass this one starts from, if any
+  std::shared_ptr<const Pass> base;
+  bool narrowing;
+};
+
+FilterEngine::FilterEngine(const RowSource &source, ThreadPool &pool)
+  : source_(source)
+  , pool_(pool)
+  , runningChunks_(0)
+{
+}
+
+FilterEngine::~FilterEngine()
+{
+  Stop();
+}
+
+void FilterEngine::SetPassDoneCallback(const std::function<void(int generation)> &callback)
+{
+  passDone_ = callback;
+}
+
+void FilterEngine::SetProgressCallback(const std::function<void(int generation, size_t doneChunks, size_t chunkCount)> &callback)
+{
+  progress_ = callback;
+}
+
+void FilterEngine::Start(int generation, const FilterSet &filters, size_t rowCount)
+{
+  auto old = std::atomic_load(&current_);
+  if (old)
+  {
+    old->cancelled = true;
+  }
+  auto pass = std::make_shared<Pass>();
+  pass->generation = generation;
+  pass->filters = filters;
+  pass->evaluator = std::make_unique<FilterEvaluator>(source_, filters);
+  pass->rowCount = rowCount;
+  pass->visible.resize((rowCount + 63) / 64);
+  pass->matches.resize((rowCount + 63) / 64);
+  const size_t chunks = (rowCount + ChunkRows - 1) / ChunkRows;
+  pass->chunkDone.reset(new std::atomic<bool>[chunks]);
+  for (size_t i = 0; i < chunks; ++i)
+  {
+    pass->chunkDone[i] = false;
+  }
+  pass->chunkCount = chunks;
+  pass->remaining = chunks;
+  pass->cancelled = false;
+  pass->base = FindBase(filters, &pass->narrowing);
+  std::atomic_store(&current_, pass);
+  if (chunks == 0)
+  {
+    PassFinished(pass);
+    if (passDone_)
+    {
+      passDone_(generation);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(runningLock_);
+    runningChunks_ += chunks;
+  }
+  for (size_t i = 0; i < chunks; ++i)
+  {
+    pool_.Submit([this, pass, i]()
+    {
+      RunChunk(pass, i);
+      std::lock_guard<std::mutex> l(runningLock_);
+      if (--runningChunks_ == 0)
+      {
+        runningDone_.notify_all();
+      }
+    });
+  }
+}
+
+void FilterEngine::Stop()
+{
+  auto pass = std::atomic_load(&current_);
+  if (pass)
+  {
+    pass->cancelled = true;
+  }
+  std::unique_lock<std::mutex> l(runningLock_);
+  runningDone_.wait(l, [this]() { return runningChunks_ == 0; });
+}
+
+void FilterEngine::Reset()
+{
+  Stop();
+  std::atomic_store(&current_, std::shared_ptr<Pass>());
+  std::lock_guard<std::mutex> l(historyLock_);
+  history_.clear();
+}
+
+std::shared_ptr<const FilterEngine::Pass> FilterEngine::FindBase(const FilterSet &filters, bool *narrowing)
+{
+  *narrowing = false;
+  std::lock_guard<std::mutex> l(historyLock_);
+  for (auto &&h : history_)
+  {
+    if (IsEquivalent(filters, h->filters))
+    {
+      return h;
+    }
+  }
+  for (auto &&h : history_)
+  {
+    if (Narrows(filters, h->filters))
+    {
+      *narrowing = true;
+      return h;
+    }
+  }
+  return nullptr;
+}
+
+void FilterEngine::PassFinished(const std::shared_ptr<Pass> &pass)
+{
+  // no chunk is left to read it and keeping it would chain every bitmap
+  pass->base.reset();
+  pass->evaluator.reset();
+  std::lock_guard<std::mutex> l(historyLock_);
+  history_.push_front(pass);
+  if (history_.size() > HistorySize)
+  {
+    history_.pop_back();
+  }
+}
+
+void FilterEngine::RunChunk(const std::shared_ptr<Pass> &pass, size_t chunk)
+{
+  const size_t firstWord = chunk * ChunkRows / 64;
+  const size_t lastRow = std::min((chunk + 1) * ChunkRows, pass->rowCount);
+  const size_t lastWord = (lastRow + 63) / 64;
+  const Pass *base = pass->base.get();
+  for (size_t w = firstWord; w < lastWord; ++w)
+  {
+    if ((w - firstWord) % CancelCheckWords == 0 && pass->cancelled)
+    {
+      return;
+    }
+    const size_t firstRow = w * 64;
+    uint64_t evaluate = LowBits(std::min(lastRow - firstRow, size_t(64)));
+    uint64_t word = 0;
+    uint64_t matchWord = 0;
+    if (base && firstRow < base->rowCount)
+    {
+      const uint64_t covered = LowBits(base->rowCount - firstRow);
+      const uint64_t known = base->visible[w] & covered;
+      const uint64_t knownMatches = base->matches[w] & covered;
+      if (pass->narrowing)
+      {
+        // rows hidden and without a match before stay so, the others need
+        // another look
+        evaluate &= known | knownMatches | ~covered;
+      }
+      else
+      {
+        word = known;
+        matchWord = knownMatches;
+        evaluate &= ~covered;
+      }
+    }
+    for (size_t bit = 0; evaluate != 0; ++bit, evaluate >>= 1)
+    {
+      if ((evaluate & 1) == 0)
+      {
+        continue;
+      }
+      bool passes = true;
+      bool match = false;
+      pass->evaluator->Evaluate(firstRow + bit, &passes, &match);
+      if (passes)
+      {
+        word |= 1ull << bit;
+      }
+      if (match)
+      {
+        matchWord |= 1ull << bit;
+      }
+    }
+    pass->visible[w] = word;
+    pass->matches[w] = matchWord;
+  }
+  pass->chunkDone[chunk].store(true, std::memory_order_release);
+  const size_t remaining = --pass->remaining;
+  if (pass->cancelled)
+  {
+    return;
+  }
+  if (remaining == 0)
+  {
+    PassFinished(pass);
+    if (passDone_)
+    {
+      passDone_(pass->generation);
+    }
+  }
+  else if (progress_)
+  {
+    progress_(pass->generation, pass->chunkCount - remaining, pass->chunkCount);
+  }
+}
+
+bool FilterEngine::Lookup(int generation, size_t row, bool *visible) const
+{
+  auto pass = std::atomic_load(&current_);
+  if (!pass || pass->generation != generation || row >= pass->rowCount)
+  {
+    return false;
+  }
+  if (!pass->chunkDone[row / ChunkRows].load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  *visible = (pass->visible[row / 64] >> (row % 64) & 1) != 0;
+  return true;
+}
+
+bool FilterEngine::HasPass(int generation) const
+{
+  auto pass = std::atomic_load(&current_);
+  return pass && pass->generation == generation && !pass->cancelled;
+}
+
+std::shared_ptr<const FilterEngine::Pass> FilterEngine::FinishedPass(int generation) const
+{
+  auto pass = std::atomic_load(&current_);
+  if (!pass || pass->generation != generation || pass->remaining != 0 || pass->cancelled)
+  {
+    return nullptr;
+  }
+  return pass;
+}
+
+bool FilterEngine::CollectVisible(int generation, std::vector<size_t> *rows, size_t *rowCount) const
+{
+  auto pass = FinishedPass(generation);
+  if (!pass)
+  {
+    return false;
+  }
+  CollectRows(pass->visible, rows);
+  *rowCount = pass->rowCount;
+  return true;
+}
+
+bool FilterEngine::CollectMatches(int generation, std::vector<size_t> *rows, size_t *rowCount) const
+{
+  auto pass = FinishedPass(generation);
+  if (!pass)
+  {
+    return false;
+  }
+  CollectRows(pass->matches, rows);
+  *rowCount = pass->rowCount;
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "filter_evaluator.h"
+#include "thread_pool.h"
+
+#include <deque>
+
+// Evaluates a filter generation over all rows in parallel. The rows are cut
+// into fixed size chunks which are handed to the thread pool, every chunk
+// fills its part of two per row bitmaps, rows passing and rows with a match,
+// and is published once complete. A newer
+// generation cancels the chunks of the previous one that have not run yet.
+// The last few finished bitmaps are kept: going back to one of those filter
+// sets reuses its bitmap and a filter set that can only match fewer rows
+// (a literal being typed) only re-tests the rows that passed before.
+class FilterEngine
+{
+public:
+  FilterEngine(const RowSource &source, ThreadPool &pool);
+  ~FilterEngine();
+  // Called from a pool thread when every chunk of a generation is done.
+  void SetPassDoneCallback(const std::function<void(int generation)> &callback);
+  // Called from a pool thread after each chunk but the last one.
+  void SetProgressCallback(const std::function<void(int generation, size_t doneChunks, size_t chunkCount)> &callback);
+  void Start(int generation, const FilterSet &filters, size_t rowCount);
+  // Cancels the current pass and waits until no chunk touches the source.
+  void Stop();
+  // Like Stop, also forgets earlier results, to be used when rows are removed.
+  void Reset();
+  // Only answers for rows in finished chunks of the given generation.
+  bool Lookup(int generation, size_t row, bool *visible) const;
+  // True if the current pass is of this generation, finished or not.
+  bool HasPass(int generation) const;
+  // Sorted list of the visible rows once every chunk of the generation is done.
+  bool CollectVisible(int generation, std::vector<size_t> *rows, size_t *rowCount) const;
+  // Same for the rows with a match.
+  bool CollectMatches(int generation, std::vector<size_t> *rows, size_t *rowCount) const;
+private:
+  struct Pass;
+  void RunChunk(const std::shared_ptr<Pass> &pass, size_t chunk);
+  void PassFinished(const std::shared_ptr<Pass> &pass);
+  std::shared_ptr<const Pass> FindBase(const FilterSet &filters, bool *narrowing);
+  std::shared_ptr<const Pass> FinishedPass(int generation) const;
+private:
+  const RowSource &source_;
+  ThreadPool &pool_;
+  std::shared_ptr<Pass> current_;
+  std::function<void(int generation)> passDone_;
+  std::function<void(int generation, size_t doneChunks, size_t chunkCount)> progress_;
+  std::mutex historyLock_;
+  std::deque<std::shared_ptr<const Pass>> history_;
+  std::mutex runningLock_;
+  std::condition_variable runningDone_;
+  size_t runningChunks_;
+};
@@ -0,0 +1,172 @@
+#include "filter_evaluator.h"
+
+namespace
+{
+
+const uint8_t Known = 1;
+const uint8_t Match = 2;
+const uint8_t Empty = 4;
+
+} // private namespace
+
+const ColumnDictionary *RowSource::Dictionary(int) const
+{
+  return nullptr;
+}
+
+// Outcome of one filter per dictionary code, filled in lazily. Racing
+// threads may both evaluate a value, they store the same result.
+class FilterEvaluator::CodeMemo
+{
+public:
+  explicit CodeMemo(const ColumnDictionary &dictionary)
+    : dictionary_(dictionary)
+    , chunks_(new std::atomic<std::atomic<uint8_t> *>[MaxChunks])
+  {
+    for (size_t i = 0; i < MaxChunks; ++i)
+    {
+      chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  ~CodeMemo()
+  {
+    for (size_t i = 0; i < MaxChunks; ++i)
+    {
+      delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+  }
+  const ColumnDictionary &Dictionary() const
+  {
+    return dictionary_;
+  }
+  uint8_t Get(uint32_t code) const
+  {
+    auto chunk = code / ChunkCodes < MaxChunks ? chunks_[code / ChunkCodes].load(std::memory_order_acquire) : nullptr;
+    return chunk ? chunk[code % ChunkCodes].load(std::memory_order_relaxed) : 0;
+  }
+  void Set(uint32_t code, uint8_t state)
+  {
+    if (code / ChunkCodes >= MaxChunks)
+    {
+      return;
+    }
+    auto &slot = chunks_[code / ChunkCodes];
+    auto chunk = slot.load(std::memory_order_acquire);
+    if (!chunk)
+    {
+      auto fresh = new std::atomic<uint8_t>[ChunkCodes];
+      for (size_t i = 0; i < ChunkCodes; ++i)
+      {
+        fresh[i].store(0, std::memory_order_relaxed);
+      }
+      if (slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel))
+      {
+        chunk = fresh;
+      }
+      else
+      {
+        delete[] fresh;
+      }
+    }
+    chunk[code % ChunkCodes].store(state, std::memory_order_relaxed);
+  }
+private:
+  static const size_t ChunkCodes = 0x1000;
+  static const size_t MaxChunks = 0x1000;
+  const ColumnDictionary &dictionary_;
+  std::unique_ptr<std::atomic<std::atomic<uint8_t> *>[]> chunks_;
+};
+
+FilterEvaluator::FilterEvaluator(const RowSource &source, const FilterSet &filters)
+  : source_(source)
+  , filters_(filters)
+  , memos_(filters.size())
+{
+  for (size_t c = 0; c < filters_.size(); ++c)
+  {
+    auto dictionary = source_.Dictionary(static_cast<int>(c));
+    if (dictionary && filters_[c]->IsActive())
+    {
+      memos_[c] = std::make_unique<CodeMemo>(*dictionary);
+    }
+  }
+}
+
+FilterEvaluator::~FilterEvaluator()
+{
+}
+
+const FilterSet &FilterEvaluator::Filters() const
+{
+  return filters_;
+}
+
+bool FilterEvaluator::IsMatch(size_t row, size_t column, bool *empty) const
+{
+  auto &&f = *filters_[column];
+  auto memo = memos_[column].get();
+  uint32_t code = 0;
+  if (memo && memo->Dictionary().Code(row, &code))
+  {
+    auto state = memo->Get(code);
+    if (state == 0)
+    {
+      auto &&value = memo->Dictionary().Value(code);
+      state = Known | (f.IsMatch(value) ? Match : 0) | (value.empty() ? Empty : 0);
+      memo->Set(code, state);
+    }
+    *empty = (state & Empty) != 0;
+    return (state & Match) != 0;
+  }
+  auto &&text = source_.CellText(row, static_cast<int>(column));
+  *empty = text.empty();
+  return f.IsMatch(text);
+}
+
+bool FilterEvaluator::Passes(size_t row) const
+{
+  for (size_t c = 0; c < filters_.size(); ++c)
+  {
+    bool empty = false;
+    if (filters_[c]->IsActive() && !IsMatch(row, c, &empty) && !empty)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FilterEvaluator::HasMatch(size_t row) const
+{
+  for (size_t c = 0; c < filters_.size(); ++c)
+  {
+    bool empty = false;
+    if (filters_[c]->IsActive() && IsMatch(row, c, &empty))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FilterEvaluator::Evaluate(size_t row, bool *passes, bool *match) const
+{
+  *passes = true;
+  *match = false;
+  for (size_t c = 0; c < filters_.size(); ++c)
+  {
+    if (!filters_[c]->IsActive())
+    {
+      continue;
+    }
+    bool empty = false;
+    if (IsMatch(row, c, &empty))
+    {
+      *match = true;
+    }
+    else if (!empty)
+    {
+      *passes = false;
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "column_dictionary.h"
+#include "column_filter.h"
+
+#include <vector>
+
+// One filter snapshot per column, indexed like the list view columns.
+using FilterSet = std::vector<std::shared_ptr<const ColumnFilter>>;
+
+// Read access to the cells the filters are evaluated against. Must be safe to
+// call from the pool threads for rows that already exist.
+class RowSource
+{
+public:
+  virtual ~RowSource() = default;
+  virtual const std::wstring &CellText(size_t row, int column) const = 0;
+  // Dictionary of a column that is dictionary coded, nullptr otherwise.
+  virtual const ColumnDictionary *Dictionary(int column) const;
+};
+
+// A filter set bound to the rows of a source. On dictionary coded columns a
+// filter runs once per distinct value, the outcome is remembered by code so
+// every further row with that value costs a table lookup. May be used from
+// several threads at once.
+class FilterEvaluator
+{
+public:
+  FilterEvaluator(const RowSource &source, const FilterSet &filters);
+  ~FilterEvaluator();
+  const FilterSet &Filters() const;
+  // A row passes when every active filter matches its column, empty cells
+  // never make a row fail.
+  bool Passes(size_t row) const;
+  // A row has a match when any active filter matches its column, this is
+  // what find next / previous stops at.
+  bool HasMatch(size_t row) const;
+  // Both of the above at once.
+  void Evaluate(size_t row, bool *passes, bool *match) const;
+private:
+  class CodeMemo;
+  bool IsMatch(size_t row, size_t column, bool *empty) const;
+private:
+  const RowSource &source_;
+  FilterSet filters_;
+  std::vector<std::unique_ptr<CodeMemo>> memos_;
+};
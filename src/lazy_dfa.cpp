@@ -0,0 +1,354 @@
+#include "lazy_dfa.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const size_t MaxNfaNodes = 0x4000;
+// once this many states exist the remaining text is simulated on the NFA,
+// still linear but without the table lookups
+const size_t MaxDfaStates = 0x1000;
+
+enum NodeType
+{
+  CharNode,
+  SplitNode,
+  BeginNode,
+  EndNode,
+  MatchNode,
+};
+
+void CollectBounds(const RegexNode &node, std::vector<uint32_t> &bounds)
+{
+  for (auto &&r : node.chars)
+  {
+    bounds.push_back(r.lo);
+    bounds.push_back(r.hi + 1);
+  }
+  for (auto &&c : node.children)
+  {
+    CollectBounds(*c, bounds);
+  }
+}
+
+bool Contains(const CharSet &set, uint32_t ch)
+{
+  auto it = std::upper_bound(set.begin(), set.end(), ch, [](uint32_t v, const CharRange &r) { return v < r.lo; });
+  return it != set.begin() && (--it)->hi >= ch;
+}
+
+struct TooLarge
+{
+};
+
+} // private namespace
+
+struct LazyDfa::NfaNode
+{
+  int type;
+  int out;
+  int out1;
+  std::vector<bool> classes;
+};
+
+struct LazyDfa::DfaState
+{
+  std::vector<int> nodes;
+  bool isMatch;
+  bool matchAtEnd;
+  bool dead;
+  std::unique_ptr<std::atomic<const DfaState *>[]> next;
+};
+
+LazyDfa::LazyDfa()
+  : start_(-1)
+  , classCount_(0)
+  , initial_(nullptr)
+{
+}
+
+LazyDfa::~LazyDfa()
+{
+}
+
+std::unique_ptr<LazyDfa> LazyDfa::Compile(const RegexNode &root)
+{
+  std::unique_ptr<LazyDfa> dfa(new LazyDfa());
+  std::vector<uint32_t> bounds{0};
+  CollectBounds(root, bounds);
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  dfa->classBounds_.swap(bounds);
+  dfa->classCount_ = static_cast<int>(dfa->classBounds_.size());
+  for (uint32_t ch = 0; ch < 0x80; ++ch)
+  {
+    auto it = std::upper_bound(dfa->classBounds_.begin(), dfa->classBounds_.end(), ch);
+    dfa->asciiClass_[ch] = static_cast<uint16_t>(it - dfa->classBounds_.begin() - 1);
+  }
+  try
+  {
+    const int match = dfa->AddNode(MatchNode, -1);
+    dfa->start_ = dfa->CompileNode(root, match);
+  }
+  catch (const TooLarge &)
+  {
+    return nullptr;
+  }
+  dfa->restart_.push_back(dfa->start_);
+  dfa->Closure(dfa->restart_, false, false);
+  std::vector<int> initial{dfa->start_};
+  dfa->Closure(initial, true, false);
+  // the initial state is the only one where ^ can match so it is kept out
+  // of the state index
+  dfa->initial_ = dfa->NewState(std::move(initial));
+  return dfa;
+}
+
+int LazyDfa::AddNode(int type, int out, int out1)
+{
+  if (nfa_.size() >= MaxNfaNodes)
+  {
+    throw TooLarge();
+  }
+  nfa_.push_back(NfaNode{type, out, out1, {}});
+  return static_cast<int>(nfa_.size() - 1);
+}
+
+int LazyDfa::CompileNode(const RegexNode &node, int next)
+{
+  switch (node.op)
+  {
+  case RegexOp::Empty:
+    return next;
+  case RegexOp::Chars:
+  {
+    const int n = AddNode(CharNode, next);
+    auto &classes = nfa_[n].classes;
+    classes.resize(classCount_);
+    for (int c = 0; c < classCount_; ++c)
+    {
+      classes[c] = Contains(node.chars, classBounds_[c]);
+    }
+    return n;
+  }
+  case RegexOp::Concat:
+    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+    {
+      next = CompileNode(**it, next);
+    }
+    return next;
+  case RegexOp::Alternate:
+  {
+    int entry = CompileNode(*node.children.back(), next);
+    for (auto it = node.children.rbegin() + 1; it != node.children.rend(); ++it)
+    {
+      entry = AddNode(SplitNode, CompileNode(**it, next), entry);
+    }
+    return entry;
+  }
+  case RegexOp::Repeat:
+  {
+    auto &child = *node.children.front();
+    int tail = next;
+    if (node.max == RegexNode::Unbounded)
+    {
+      const int loop = AddNode(SplitNode, -1, next);
+      nfa_[loop].out = CompileNode(child, loop);
+      tail = loop;
+    }
+    else
+    {
+      for (int i = node.min; i < node.max; ++i)
+      {
+        const int optional = CompileNode(child, tail);
+        tail = AddNode(SplitNode, optional, next);
+      }
+    }
+    for (int i = 0; i < node.min; ++i)
+    {
+      tail = CompileNode(child, tail);
+    }
+    return tail;
+  }
+  case RegexOp::BeginText:
+    return AddNode(BeginNode, next);
+  case RegexOp::EndText:
+    return AddNode(EndNode, next);
+  }
+  return next;
+}
+
+int LazyDfa::ClassOf(uint32_t ch) const
+{
+  if (ch < 0x80)
+  {
+    return asciiClass_[ch];
+  }
+  auto it = std::upper_bound(classBounds_.begin(), classBounds_.end(), ch);
+  return static_cast<int>(it - classBounds_.begin() - 1);
+}
+
+void LazyDfa::Closure(std::vector<int> &states, bool atBegin, bool atEnd) const
+{
+  std::vector<int> stack;
+  stack.swap(states);
+  std::vector<bool> seen(nfa_.size());
+  while (!stack.empty())
+  {
+    const int s = stack.back();
+    stack.pop_back();
+    if (s < 0 || seen[s])
+    {
+      continue;
+    }
+    seen[s] = true;
+    auto &node = nfa_[s];
+    switch (node.type)
+    {
+    case SplitNode:
+      stack.push_back(node.out1);
+      stack.push_back(node.out);
+      break;
+    case BeginNode:
+      if (atBegin)
+      {
+        stack.push_back(node.out);
+      }
+      break;
+    case EndNode:
+      if (atEnd)
+      {
+        stack.push_back(node.out);
+      }
+      else
+      {
+        states.push_back(s);
+      }
+      break;
+    default:
+      states.push_back(s);
+      break;
+    }
+  }
+  std::sort(states.begin(), states.end());
+}
+
+bool LazyDfa::MatchesAtEnd(const std::vector<int> &states, bool atBegin) const
+{
+  std::vector<int> final = states;
+  Closure(final, atBegin, true);
+  return std::any_of(final.begin(), final.end(), [this](int s) { return nfa_[s].type == MatchNode; });
+}
+
+std::vector<int> LazyDfa::Step(const std::vector<int> &states, int cls) const
+{
+  std::vector<int> next;
+  for (auto s : states)
+  {
+    auto &node = nfa_[s];
+    if (node.type == CharNode && node.classes[cls])
+    {
+      next.push_back(node.out);
+    }
+  }
+  next.insert(next.end(), restart_.begin(), restart_.end());
+  Closure(next, false, false);
+  return next;
+}
+
+const LazyDfa::DfaState *LazyDfa::NewState(std::vector<int> &&states) const
+{
+  auto state = std::make_unique<DfaState>();
+  state->isMatch = std::any_of(states.begin(), states.end(), [this](int s) { return nfa_[s].type == MatchNode; });
+  state->matchAtEnd = state->isMatch || MatchesAtEnd(states, false);
+  state->dead = states.empty();
+  state->nodes = std::move(states);
+  state->next.reset(new std::atomic<const DfaState *>[classCount_]);
+  for (int c = 0; c < classCount_; ++c)
+  {
+    state->next[c].store(nullptr, std::memory_order_relaxed);
+  }
+  states_.push_back(std::move(state));
+  return states_.back().get();
+}
+
+const LazyDfa::DfaState *LazyDfa::Transition(const DfaState *state, int cls) const
+{
+  auto next = Step(state->nodes, cls);
+  std::lock_guard<std::mutex> l(buildLock_);
+  auto it = stateIndex_.find(next);
+  const DfaState *target = nullptr;
+  if (it != stateIndex_.end())
+  {
+    target = it->second;
+  }
+  else
+  {
+    if (states_.size() >= MaxDfaStates)
+    {
+      return nullptr;
+    }
+    auto key = next;
+    target = NewState(std::move(next));
+    stateIndex_.emplace(std::move(key), target);
+  }
+  state->next[cls].store(target, std::memory_order_release);
+  return target;
+}
+
+bool LazyDfa::Simulate(std::vector<int> states, const wchar_t *p, const wchar_t *end) const
+{
+  for (; p < end; ++p)
+  {
+    states = Step(states, ClassOf(FoldCase(static_cast<uint32_t>(*p))));
+    if (states.empty())
+    {
+      return false;
+    }
+    for (auto s : states)
+    {
+      if (nfa_[s].type == MatchNode)
+      {
+        return true;
+      }
+    }
+  }
+  return MatchesAtEnd(states, false);
+}
+
+bool LazyDfa::Search(const wchar_t *begin, const wchar_t *end) const
+{
+  const DfaState *state = initial_;
+  if (state->isMatch)
+  {
+    return true;
+  }
+  if (begin == end)
+  {
+    return MatchesAtEnd(state->nodes, true);
+  }
+  for (auto p = begin; p < end; ++p)
+  {
+    const int cls = ClassOf(FoldCase(static_cast<uint32_t>(*p)));
+    auto next = state->next[cls].load(std::memory_order_acquire);
+    if (!next)
+    {
+      next = Transition(state, cls);
+      if (!next)
+      {
+        return Simulate(state->nodes, p, end);
+      }
+    }
+    state = next;
+    if (state->isMatch)
+    {
+      return true;
+    }
+    if (state->dead)
+    {
+      return false;
+    }
+  }
+  return state->matchAtEnd;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "regex_syntax.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+// Unanchored, case insensitive search over a Thompson NFA whose DFA states
+// are built on demand. Every character is inspected exactly once so run time
+// is linear in the subject length whatever the pattern looks like. Search may
+// be called concurrently, states are only ever added and published with
+// release semantics.
+class LazyDfa
+{
+public:
+  // Returns nullptr if the NFA would get too large.
+  static std::unique_ptr<LazyDfa> Compile(const RegexNode &root);
+  ~LazyDfa();
+  bool Search(const wchar_t *begin, const wchar_t *end) const;
+
+private:
+  struct NfaNode;
+  struct DfaState;
+
+  LazyDfa();
+  int ClassOf(uint32_t ch) const;
+  int CompileNode(const RegexNode &node, int next);
+  int AddNode(int type, int out, int out1 = -1);
+  void Closure(std::vector<int> &states, bool atBegin, bool atEnd) const;
+  bool MatchesAtEnd(const std::vector<int> &states, bool atBegin) const;
+  std::vector<int> Step(const std::vector<int> &states, int cls) const;
+  const DfaState *Transition(const DfaState *state, int cls) const;
+  const DfaState *NewState(std::vector<int> &&states) const;
+  bool Simulate(std::vector<int> states, const wchar_t *p, const wchar_t *end) const;
+
+private:
+  std::vector<NfaNode> nfa_;
+  int start_;
+  std::vector<int> restart_;
+  // alphabet compression, code units in the same class behave identically
+  std::vector<uint32_t> classBounds_;
+  uint16_t asciiClass_[0x80];
+  int classCount_;
+  // lazily built automaton
+  mutable std::mutex buildLock_;
+  mutable std::map<std::vector<int>, const DfaState *> stateIndex_;
+  mutable std::vector<std::unique_ptr<DfaState>> states_;
+  const DfaState *initial_;
+};
@@ -0,0 +1,127 @@
+#include "line_framer.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ETRACE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+inline unsigned LowestBit(unsigned mask)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline bool IsSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+} // private namespace
+
+const char *FindByte(const char *begin, const char *end, char c)
+{
+  const char *p = begin;
+#if ETRACE_SSE2
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; end - p >= 16; p += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+    if (mask != 0)
+    {
+      return p + LowestBit(mask);
+    }
+  }
+#endif
+  auto found = static_cast<const char *>(memchr(p, c, end - p));
+  return found ? found : end;
+}
+
+LineFramer::LineFramer(size_t readSize, size_t maxLineLength, char delimiter)
+  : readSize_(readSize)
+  , maxLineLength_(maxLineLength)
+  , delimiter_(delimiter)
+  , buffer_(readSize * 2)
+  , begin_(0)
+  , end_(0)
+{
+}
+
+char *LineFramer::ReadBuffer()
+{
+  if (buffer_.size() - end_ < readSize_)
+  {
+    // only the unfinished line is kept
+    memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+    if (buffer_.size() - end_ < readSize_)
+    {
+      buffer_.resize(end_ + readSize_);
+    }
+  }
+  return buffer_.data() + end_;
+}
+
+size_t LineFramer::ReadSize() const
+{
+  return readSize_;
+}
+
+void LineFramer::Consume(size_t bytes, const LineHandler &onLine)
+{
+  // the tail was searched by the previous call already
+  const char *data = buffer_.data();
+  const char *scan = data + end_;
+  end_ += bytes;
+  const char *end = data + end_;
+  for (;;)
+  {
+    const char *nl = FindByte(scan, end, delimiter_);
+    if (nl == end)
+    {
+      break;
+    }
+    Emit(begin_, nl - data, onLine);
+    begin_ = nl - data + 1;
+    scan = nl + 1;
+  }
+  if (end_ - begin_ > maxLineLength_)
+  {
+    Emit(begin_, end_, onLine);
+    begin_ = end_;
+  }
+}
+
+void LineFramer::Emit(size_t begin, size_t end, const LineHandler &onLine) const
+{
+  const char *line = buffer_.data() + begin;
+  size_t length = end - begin;
+  while (delimiter_ == '\n' && length > 0 && IsSpace(line[length - 1]))
+  {
+    --length;
+  }
+  if (length > 0)
+  {
+    onLine(line, length);
+  }
+}
+
+void LineFramer::Clear()
+{
+  begin_ = 0;
+  end_ = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// Cuts the bytes of a serial port into lines, or into records ended by a
+// zero byte for the binary protocol, without copying them. Reads go
+// straight into the framer's buffer, complete lines are handed out as spans
+// into it and only the unfinished tail is moved to the front before the next
+// read, so the buffer stops growing once it holds the longest line.
+class LineFramer
+{
+public:
+  using LineHandler = std::function<void(const char *line, size_t length)>;
+  explicit LineFramer(size_t readSize = 0x800, size_t maxLineLength = 0x10000, char delimiter = '\n');
+  // Room for the next read, valid until Consume.
+  char *ReadBuffer();
+  size_t ReadSize() const;
+  // Frames the bytes read into ReadBuffer. Lines come without the delimiter,
+  // text lines also without trailing white space, empty ones are skipped. A
+  // line growing past maxLineLength is handed out in pieces.
+  void Consume(size_t bytes, const LineHandler &onLine);
+  // Drops the unfinished line, e.g. after reconnecting.
+  void Clear();
+private:
+  void Emit(size_t begin, size_t end, const LineHandler &onLine) const;
+private:
+  size_t readSize_;
+  size_t maxLineLength_;
+  char delimiter_;
+  std::vector<char> buffer_;
+  // start of the unfinished line and end of the data
+  size_t begin_;
+  size_t end_;
+};
+
+// Position of the first c in [begin, end), end if there is none.
+const char *FindByte(const char *begin, const char *end, char c);
@@ -0,0 +1,178 @@
+#include "literal_scan.h"
+#include "regex_syntax.h"
+
+#include <cwchar>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ETRACE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define ETRACE_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+inline unsigned LowestBit(unsigned mask)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+#if ETRACE_SSE2 && WCHAR_MAX == 0xFFFF
+// 'A'..'Z' -> 'a'..'z', everything else untouched
+inline __m128i FoldAscii(__m128i v)
+{
+  const __m128i offset = _mm_sub_epi16(v, _mm_set1_epi16('A'));
+  // unsigned offset < 26 using signed compares
+  const __m128i upper = _mm_cmplt_epi16(_mm_xor_si128(offset, _mm_set1_epi16(-0x8000)), _mm_set1_epi16(-0x8000 + 26));
+  return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+}
+
+inline bool IsAscii(__m128i v)
+{
+  const __m128i high = _mm_and_si128(v, _mm_set1_epi16(-0x80));
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+#if ETRACE_AVX2 && WCHAR_MAX == 0xFFFF
+inline __m256i FoldAscii(__m256i v)
+{
+  const __m256i offset = _mm256_sub_epi16(v, _mm256_set1_epi16('A'));
+  const __m256i upper = _mm256_cmpgt_epi16(_mm256_set1_epi16(-0x8000 + 26), _mm256_xor_si256(offset, _mm256_set1_epi16(-0x8000)));
+  return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi16(0x20)));
+}
+
+inline bool IsAscii(__m256i v)
+{
+  const __m256i high = _mm256_and_si256(v, _mm256_set1_epi16(-0x80));
+  return _mm256_testz_si256(high, high) != 0;
+}
+#endif
+
+} // private namespace
+
+LiteralScanner::LiteralScanner(const std::wstring &foldedNeedle)
+  : needle_(foldedNeedle)
+{
+}
+
+const std::wstring &LiteralScanner::Needle() const
+{
+  return needle_;
+}
+
+bool LiteralScanner::MatchesAt(const wchar_t *p) const
+{
+  for (size_t i = 0; i < needle_.length(); ++i)
+  {
+    if (FoldCase(static_cast<uint32_t>(p[i])) != static_cast<uint32_t>(needle_[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LiteralScanner::FindScalar(const wchar_t *begin, const wchar_t *end, const wchar_t *last) const
+{
+  // candidates start in [begin, end), last is the final valid start position
+  const auto first = static_cast<uint32_t>(needle_[0]);
+  for (auto p = begin; p < end && p <= last; ++p)
+  {
+    if (FoldCase(static_cast<uint32_t>(*p)) == first && MatchesAt(p))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LiteralScanner::Find(const wchar_t *begin, const wchar_t *end) const
+{
+  const size_t n = needle_.length();
+  if (n == 0)
+  {
+    return true;
+  }
+  if (static_cast<size_t>(end - begin) < n)
+  {
+    return false;
+  }
+  const wchar_t *last = end - n;
+  const wchar_t *p = begin;
+#if WCHAR_MAX == 0xFFFF
+#if ETRACE_AVX2
+  {
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(needle_[0]));
+    const __m256i final = _mm256_set1_epi16(static_cast<short>(needle_[n - 1]));
+    for (; p + 16 <= last + 1; p += 16)
+    {
+      const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + n - 1));
+      if (!IsAscii(_mm256_or_si256(a, b)))
+      {
+        if (FindScalar(p, p + 16, last))
+        {
+          return true;
+        }
+        continue;
+      }
+      unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi16(FoldAscii(a), first),
+                                                                                    _mm256_cmpeq_epi16(FoldAscii(b), final))));
+      while (mask)
+      {
+        const unsigned bit = LowestBit(mask);
+        if (MatchesAt(p + bit / 2))
+        {
+          return true;
+        }
+        mask &= ~(3u << bit);
+      }
+    }
+  }
+#endif
+#if ETRACE_SSE2
+  {
+    const __m128i first = _mm_set1_epi16(static_cast<short>(needle_[0]));
+    const __m128i final = _mm_set1_epi16(static_cast<short>(needle_[n - 1]));
+    for (; p + 8 <= last + 1; p += 8)
+    {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + n - 1));
+      if (!IsAscii(_mm_or_si128(a, b)))
+      {
+        if (FindScalar(p, p + 8, last))
+        {
+          return true;
+        }
+        continue;
+      }
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(FoldAscii(a), first),
+                                                                           _mm_cmpeq_epi16(FoldAscii(b), final))));
+      while (mask)
+      {
+        const unsigned bit = LowestBit(mask);
+        if (MatchesAt(p + bit / 2))
+        {
+          return true;
+        }
+        mask &= ~(3u << bit);
+      }
+    }
+  }
+#endif
+#endif
+  return FindScalar(p, end, last);
+}
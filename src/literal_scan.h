@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+// Case insensitive substring search for a needle that is already case folded
+// (see FoldCase). Blocks of ASCII text are compared with SSE2/AVX2, only the
+// candidate positions and blocks holding other characters are checked one
+// code unit at a time.
+class LiteralScanner
+{
+public:
+  explicit LiteralScanner(const std::wstring &foldedNeedle);
+  bool Find(const wchar_t *begin, const wchar_t *end) const;
+  const std::wstring &Needle() const;
+private:
+  bool MatchesAt(const wchar_t *p) const;
+  bool FindScalar(const wchar_t *begin, const wchar_t *end, const wchar_t *last) const;
+private:
+  std::wstring needle_;
+};
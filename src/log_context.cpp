@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "log_context.h"
+#include "column_filter.h"
+#include "text_encoding.h"
 #include "win_util.h"
 #include "resource.h"
 
@@ -13,6 +15,40 @@ namespace
 {
 
 static wchar_t *columnNames[] = {L"ID", L"LOG", L"PROCESS", L"THREAD", L"FILE", L"FUNCTION", L"TIMESTAMP", L"MESSAGE"};
+// LOG, PROCESS, THREAD, FILE and FUNCTION repeat a handful of values over
+// and over and are dictionary coded
+const int firstCodedColumn = 1;
+const int lastCodedColumn = 5;
+// values of a column that get a palette color of their own when coloring by
+// a column that is not dictionary coded, all others get a hashed color
+const size_t frequentValueColors = 8;
+// color weight of rows not passing the column filters
+const float filteredRowFade = 0.37f;
+// quiet time after the last keystroke in a filter box before filtering
+const UINT filterDelayMs = 150;
+// new rows and column widths reach the view at about 30 Hz
+const UINT viewRefreshMs = 33;
+// currentMatchingLine_ while nothing has been found
+const size_t noMatchingLine = std::numeric_limits<size_t>::max();
+// the ingest thread looks for a stop request at least this often
+const int ingestWaitMs = 100;
+// text logs from this size on are parsed row by row as they are read
+const uintmax_t lazyTextLogBytes = 0x10000000;
+// rows of a lazy store looked at per column and arrival for the statistics
+// and widths of the columns it does not code
+const size_t statsSampleRows = 0x100;
+
+FILETIME AddMicroseconds(const FILETIME &ft, uint64_t us)
+{
+  ULARGE_INTEGER t;
+  t.LowPart = ft.dwLowDateTime;
+  t.HighPart = ft.dwHighDateTime;
+  t.QuadPart += us * 10;
+  FILETIME rv;
+  rv.dwLowDateTime = t.LowPart;
+  rv.dwHighDateTime = t.HighPart;
+  return rv;
+}
 
 etl::TraceEventDataItem ColumnToDataItem(int column)
 {
@@ -53,45 +89,6 @@ int DataItemToColumn(etl::TraceEventDataItem item)
   return -1;
 }
 
-bool ValidRegEx(const std::wstring &txt)
-{
-  if(txt.empty())
-  {
-    return false;
-  }
-  wchar_t last = 0;
-  int bsCount = 0;
-  int brackets = 0;
-  for(auto ch : txt)
-  {
-    if((bsCount & 1) == 1 && last == L'\\' && ch >= L'0' && ch <= L'9')
-    {
-      return false;
-    }
-    if(ch == L'\\')
-    {
-      ++bsCount;
-    }
-    else
-    {
-      bsCount = 0;
-      if ((bsCount & 1) == 0 ||last != L'\\')
-      {
-        if (ch == L'[')
-        {
-          ++brackets;
-        }
-        if (ch == L']')
-        {
-          --brackets;
-        }
-      }
-    }
-    last = ch;
-  }
-  return (bsCount & 1) != 1 && brackets == 0;
-}
-
 bool UseWhiteText(COLORREF c)
 {
   return __max(GetRValue(c), __max(GetGValue(c), GetBValue(c))) < 0x80 || (GetRValue(c) < 0x10 && GetGValue(c) < 0x10);
@@ -113,42 +110,90 @@ COLORREF GenerateColor(int current, int unique_element_count)
   return colors[current % _countof(colors)];
 }
 
-} // private namespace
+std::vector<ExportField> ExportFields(int columnCount)
+{
+  std::vector<ExportField> fields;
+  for (int c = 0; c < columnCount; ++c)
+  {
+    auto type = ExportField::Type::Text;
+    switch (ColumnToDataItem(c))
+    {
+    case etl::TraceEventDataItem::TraceIndex:
+    case etl::TraceEventDataItem::ProcessId:
+    case etl::TraceEventDataItem::ThreadId:
+      type = ExportField::Type::Number;
+      break;
+    case etl::TraceEventDataItem::TimeStamp:
+      type = ExportField::Type::Time;
+      break;
+    }
+    fields.push_back({columnNames[c], ColumnToDataItem(c), type});
+  }
+  return fields;
+}
 
-////////////////////////
+ExportFormat ExportFormatOf(const fs::path &filePath)
+{
+  if (filePath.extension() == ".csv")
+  {
+    return ExportFormat::Csv;
+  }
+  if (filePath.extension() == ".jsonl" || filePath.extension() == ".json")
+  {
+    return ExportFormat::JsonLines;
+  }
+  return ExportFormat::Text;
+}
 
-RowContext::RowContext()
-  : colorFade(1.0f)
-  , lastFilterCount(-1)
-  , groupId(0)
+std::vector<size_t> EnumerateRows(const std::function<bool(size_t *n)> &enumerator)
 {
+  std::vector<size_t> rows;
+  size_t n = std::numeric_limits<size_t>::max();
+  while (enumerator(&n))
+  {
+    rows.push_back(n);
+  }
+  return rows;
 }
 
+} // private namespace
+
+////////////////////////
+
 ///////////////////////
 
 ColumnContext::ColumnContext(HWND fWnd, float ratio, LogContext *owner)
   : filterWindow(fWnd)
   , sizeRatio(ratio)
+  , dictionary(nullptr)
+  , measuredValues(0)
   , longestTextLength_(0)
   , owner_(owner)
   , orgProc_(nullptr)
+  , filter_(std::make_shared<ColumnFilter>())
 {
 }
 
 bool ColumnContext::SetFilterText(const wchar_t *txt, int len)
 {
   std::wstring newFilt(txt, len);
-  bool rv = false;
-  std::lock_guard<std::mutex> l(filterTextLock_);
-  rv = filterText_ != newFilt;
-  filterText_.swap(newFilt);
-  return rv;
+  if (GetFilter()->Text() == newFilt)
+  {
+    return false;
+  }
+  // compile once here instead of once per evaluated cell
+  std::atomic_store(&filter_, std::shared_ptr<const ColumnFilter>(std::make_shared<ColumnFilter>(newFilt)));
+  return true;
 }
 
 std::wstring ColumnContext::GetFilterText() const
 {
-  std::lock_guard<std::mutex> l(filterTextLock_);
-  return filterText_;
+  return GetFilter()->Text();
+}
+
+std::shared_ptr<const ColumnFilter> ColumnContext::GetFilter() const
+{
+  return std::atomic_load(&filter_);
 }
 
 
@@ -160,11 +205,48 @@ LogContext::LogContext(HINSTANCE programInstance)
   , listView_(nullptr)
   , itemCounter_(0)
   , selectedColumn_(-1)
+  , needRedraw_(false)
   , filterId_(0)
   , groupCounter_(0)
-  , currentMatchingLine_(std::numeric_limits<size_t>::max())
+  , currentMatchingLine_(noMatchingLine)
   , baudRate_(921600)
+  , runComThread_(false)
+  , filterEngine_(*this, filterPool_)
+  , hideNonMatching_(false)
+  , viewIndex_(&FilterEvaluator::Passes)
+  , matchIndex_(&FilterEvaluator::HasMatch)
+  , filterDebounce_(std::chrono::milliseconds(filterDelayMs))
+  , injecting_(false)
+  , countedRows_(0)
+  , sampleStats_(false)
+  , publishedRows_(0)
+  , runIngestThread_(false)
+  , jobId_(0)
+  , cancelJob_(false)
+  , jobDoneRows_(0)
+  , jobTotalRows_(0)
+{
+  filterEngine_.SetPassDoneCallback([this](int generation)
+  {
+    if (mainWindow_)
+    {
+      PostMessageW(mainWindow_, WM_FILTERPASSDONE, generation, 0);
+    }
+  });
+  filterEngine_.SetProgressCallback([this](int generation, size_t doneChunks, size_t chunkCount)
+  {
+    // one message per percent is plenty
+    const auto percent = doneChunks * 100 / chunkCount;
+    if (mainWindow_ && percent != (doneChunks - 1) * 100 / chunkCount)
+    {
+      PostMessageW(mainWindow_, WM_FILTERPROGRESS, generation, static_cast<LPARAM>(percent));
+    }
+  });
+}
+
+LogContext::~LogContext()
 {
+  StopJob();
 }
 
 template <typename T>
@@ -180,31 +262,61 @@ inline COLORREF ColorLerp(COLORREF c1, COLORREF c2, double t)
     lerp(GetBValue(c1), GetBValue(c2), t));
 }
 
-float LogContext::GetFilterLineFade(size_t line)
+inline COLORREF HashColor(const std::wstring &value)
+{
+  // FNV-1a, the same value gets the same color in every run
+  uint32_t h = 2166136261u;
+  for (auto ch : value)
+  {
+    h ^= static_cast<uint32_t>(ch);
+    h *= 16777619u;
+  }
+  return ColorLerp(GenerateColor(static_cast<int>(h & 0xFFFF), 0), RGB(0x55, 0x55, 0x55), ((h >> 16) & 3) / 8.0);
+}
+
+void LogContext::UpdateFades(size_t first, size_t last)
 {
-  for (auto &&flt : colorFilters_)
+  // finished chunks of the current pass answer from its bitmap, rows it has
+  // not reached yet are tested against one snapshot of the filters
+  std::unique_ptr<FilterEvaluator> evaluator;
+  for (auto pos = first; pos < last; ++pos)
   {
-    for (int c = 0; c < _countof(columnNames); ++c)
+    const auto row = ViewToRow(pos);
+    if (rowState_.LastFilterCount(row) == filterId_)
+    {
+      continue;
+    }
+    bool visible = true;
+    if (!filterEngine_.Lookup(filterId_, row, &visible))
     {
-      auto item = ColumnToDataItem(c);
-      if (item != etl::TraceEventDataItem::MAX_ITEM)
+      if (!evaluator)
       {
-        auto &&text = logTrace_->GetItemValue(line, item);
-        if (flt.first(c, text))
-        {
-          return flt.second;
-        }
+        evaluator = std::make_unique<FilterEvaluator>(static_cast<const RowSource &>(*this), CurrentFilters());
       }
+      visible = evaluator->Passes(row);
     }
+    rowState_.SetFade(row, visible ? 1.0f : filteredRowFade, filterId_);
+  }
+}
+
+void LogContext::UpdateVisibleFades()
+{
+  if (!logTrace_)
+  {
+    return;
   }
-  return 1.0f;
+  const auto count = ViewItemCount();
+  const auto top = static_cast<size_t>(ListView_GetTopIndex(listView_));
+  // one more for the partially visible row at the bottom
+  const auto last = __min(count, top + ListView_GetCountPerPage(listView_) + 1);
+  UpdateFades(top, last);
 }
 
 bool LogContext::ResetViewNoInvalidate()
 {
   bool invalidate = selectedColumn_ >= 0;
   selectedColumn_ = -1;
-  currentMatchingLine_ = -1;
+  currentMatchingLine_ = noMatchingLine;
   for (auto &c : columns_)
   {
     SetWindowTextW(c->filterWindow, L"");
@@ -216,48 +328,62 @@ bool LogContext::ResetViewNoInvalidate()
   return invalidate;
 }
 
-void LogContext::InitializeRowContext(size_t line)
-{
-  auto md = logTrace_->GetItemMetadata(line);
-  if (!md)
-  {
-    std::lock_guard<std::mutex> l(rowInfoLock_);
-    rowInfo_.push_back(std::make_unique<RowContext>());
-    logTrace_->SetItemMetadata(line, rowInfo_.back().get());
-  }
-}
-
-RowContext *LogContext::GetRowContext(size_t line)
-{
-  return reinterpret_cast<RowContext *>(logTrace_->GetItemMetadata(line));
-}
-
-const RowContext *LogContext::GetRowContext(size_t line) const
-{
-  return reinterpret_cast<const RowContext *>(logTrace_->GetItemMetadata(line));
-}
-
 std::function<bool(size_t*n)> LogContext::SelectedLinesEnumerator() const
 {
-  return std::function<bool(size_t*n)>([this](size_t *n)
+  // rows and list view positions differ while non-matching rows are hidden
+  // so the position is kept aside
+  auto pos = std::make_shared<int>(-1);
+  return std::function<bool(size_t*n)>([this, pos](size_t *n)
   {
-    int pos = *n == std::numeric_limits<size_t>::max() ? -1 : *n;
-    pos = ListView_GetNextItem(listView_, pos, LVNI_SELECTED);
-    if (pos >= 0)
+    if (*n == std::numeric_limits<size_t>::max())
+    {
+      *pos = -1;
+    }
+    *pos = ListView_GetNextItem(listView_, *pos, LVNI_SELECTED);
+    if (*pos >= 0)
     {
-      *n = pos;
+      *n = ViewToRow(*pos);
       return true;
     }
     return false;
   });
 }
 
+void LogContext::ResetRows()
+{
+  // everything indexed by row, a job and the engine go first as they read
+  // the rows and the dictionaries
+  StopJob();
+  filterEngine_.Reset();
+  viewIndex_.Clear();
+  matchIndex_.Clear();
+  rowState_.Clear();
+  viewUpdates_.Reset();
+  countedRows_ = 0;
+  publishedRows_ = 0;
+  for (auto &c : columns_)
+  {
+    if (c->ownDictionary)
+    {
+      c->ownDictionary->Clear();
+    }
+    c->measuredValues = 0;
+    c->codeColor.clear();
+    c->savedCodeColor.clear();
+    c->stats.Clear();
+    c->frequentColor.clear();
+  }
+}
+
 void LogContext::ApplyFilters()
 {
+  filterDebounce_.Cancel();
+  KillTimer(mainWindow_, IDT_FILTERDEBOUNCE);
   if(logTrace_)
   {
     logTrace_->ApplyFilters();
     ++filterId_;
+    filterEngine_.Start(filterId_, CurrentFilters(), publishedRows_.load(std::memory_order_acquire));
   }
 }
 
@@ -271,21 +397,57 @@ bool LogContext::AddPdbProvider(const fs::path &pdbPath)
 bool LogContext::InitializeLiveSession(const std::wstring &sessionName)
 {
   sessionName_ = sessionName;
-  logTrace_ = std::make_unique<etl::LiveTraceEnumerator>(fmtDb_, sessionName);
+  ResetRows();
+  logTrace_ = std::make_unique<EnumeratorStore>(std::make_unique<etl::LiveTraceEnumerator>(fmtDb_, sessionName));
+  sampleStats_ = false;
+  UseStoreDictionaries();
   windowTitle_ = sessionName + L" - LIVE ETRACE";
   return true;
 }
 
 bool LogContext::LoadEventLogFile(const fs::path &etlPath)
 {
-  if (etlPath.extension() == ".etl")
+  std::unique_ptr<SnapshotStore> snapshot;
+  if (etlPath.extension() == ".etrace")
+  {
+    // a broken snapshot leaves the open log as it is
+    snapshot = std::make_unique<SnapshotStore>(etlPath);
+    if (!snapshot->Open())
+    {
+      return false;
+    }
+  }
+  ResetRows();
+  if (snapshot)
   {
-    logTrace_ = std::make_unique<etl::LogfileEnumerator>(fmtDb_, etlPath);
+    RestoreSnapshotState(*snapshot);
+    logTrace_ = std::move(snapshot);
+    sampleStats_ = false;
+  }
+  else if (etlPath.extension() == ".etl")
+  {
+    logTrace_ = std::make_unique<EnumeratorStore>(std::make_unique<etl::LogfileEnumerator>(fmtDb_, etlPath));
+    sampleStats_ = false;
   }
   else
   {
-    logTrace_ = std::make_unique<etl::TxtfileEnumerator>(fmtDb_, etlPath);
+    TextLogStore::Columns columns;
+    for (int i = 0; i < _countof(columnNames); ++i)
+    {
+      columns.emplace_back(columnNames[i], ColumnToDataItem(i));
+    }
+    std::vector<etl::TraceEventDataItem> codedItems;
+    for (int i = firstCodedColumn; i <= lastCodedColumn; ++i)
+    {
+      codedItems.push_back(ColumnToDataItem(i));
+    }
+    std::error_code ec;
+    const bool lazy = fs::file_size(etlPath, ec) >= lazyTextLogBytes && !ec;
+    logTrace_ = std::make_unique<TextLogStore>(etlPath, columns, lazy, codedItems);
+    // reading every value here would parse every line on the loader thread
+    sampleStats_ = lazy;
   }
+  UseStoreDictionaries();
   windowTitle_ = etlPath.filename().wstring() + L" - ETRACE LOG";
   return true;
 }
@@ -341,6 +503,11 @@ bool LogContext::InitTraceList()
     x += colWidth;
     //
     columns_.push_back(std::make_unique<ColumnContext>(cbWnd, ratio, this));
+    if (i >= firstCodedColumn && i <= lastCodedColumn)
+    {
+      columns_.back()->ownDictionary = std::make_unique<ColumnDictionary>();
+      columns_.back()->dictionary = columns_.back()->ownDictionary.get();
+    }
     POINT pt = { 0, 0 };
     HWND hwndEdit;
     // find first window within the combo box that isn't the combo box itself
@@ -362,6 +529,8 @@ bool LogContext::InitTraceList()
     ListView_InsertColumn(listView_, i, &col);
     ListView_SetColumnWidth(listView_, i, colWidth);
   }
+  // a log given on the command line is opened before the list exists
+  UseStoreDictionaries();
 
   return TRUE;
 }
@@ -413,17 +582,230 @@ bool LogContext::FilterColumn(etl::TraceEventDataItem item, const std::wstring &
   {
     return rv;
   }
-  auto res = columns_[column]->GetFilterText();
-  if (ValidRegEx(res))
+  return columns_[column]->GetFilter()->IsMatch(txt, rv);
+}
+
+const std::wstring &LogContext::CellText(size_t row, int column) const
+{
+  return logTrace_->GetItemValue(row, ColumnToDataItem(column));
+}
+
+const ColumnDictionary *LogContext::Dictionary(int column) const
+{
+  return column < ColumnCount() ? columns_[column]->dictionary : nullptr;
+}
+
+void LogContext::UseStoreDictionaries()
+{
+  // right after the store changed, the old one may be gone already
+  for (int i = 1; i < ColumnCount(); ++i)
   {
-    std::wregex r(res, std::regex_constants::icase);
-    rv = std::regex_search(txt, r);
+    auto &c = *columns_[i];
+    const auto item = ColumnToDataItem(i);
+    auto stored = logTrace_ && item != etl::TraceEventDataItem::MAX_ITEM ? logTrace_->Dictionary(item) : nullptr;
+    c.dictionary = stored ? stored : c.ownDictionary.get();
+    c.measuredValues = 0;
   }
-  return rv;
+}
+
+bool LogContext::CodeRows(ColumnContext &column, etl::TraceEventDataItem item, size_t rowCount)
+{
+  if (!column.dictionary)
+  {
+    return false;
+  }
+  // only a value seen for the first time can change the longest text
+  if (!column.ownDictionary || column.dictionary != column.ownDictionary.get())
+  {
+    // coded by the store, rows past its coded ones go through the plain
+    // strings like those of a full dictionary
+    const auto size = column.dictionary->Size();
+    for (auto code = column.measuredValues; code < size; ++code)
+    {
+      column.longestTextLength_ = __max(column.longestTextLength_, column.dictionary->Value(static_cast<uint32_t>(code)).length());
+    }
+    column.measuredValues = size;
+    return column.dictionary->CodedRows() >= rowCount;
+  }
+  for (auto row = column.ownDictionary->CodedRows(); row < rowCount; ++row)
+  {
+    auto &&s = logTrace_->GetItemValue(row, item);
+    uint32_t code = 0;
+    bool added = false;
+    if (!column.ownDictionary->Append(row, s, &code, &added))
+    {
+      // full, the remaining rows go through the plain strings
+      return false;
+    }
+    if (added)
+    {
+      column.longestTextLength_ = __max(column.longestTextLength_, s.length());
+    }
+  }
+  return true;
+}
+
+ColorInfo &LogContext::CodeColor(ColumnContext &column, uint32_t code)
+{
+  // grown on the UI thread only, codes number the values in order of
+  // appearance just like the index of the string keyed colors
+  if (code >= column.codeColor.size())
+  {
+    const auto old = column.codeColor.size();
+    column.codeColor.resize(code + 1);
+    for (auto i = old; i < column.codeColor.size(); ++i)
+    {
+      auto saved = column.savedCodeColor.find(column.dictionary->Value(static_cast<uint32_t>(i)));
+      column.codeColor[i] = saved != column.savedCodeColor.end() ? saved->second : ColorInfo{0, static_cast<int>(i + 1), 0, 0};
+    }
+  }
+  return column.codeColor[code];
+}
+
+bool LogContext::CellColor(int column, size_t row, ColorInfo *ci)
+{
+  auto &c = *columns_[column];
+  uint32_t code = 0;
+  if (c.dictionary && c.dictionary->Code(row, &code))
+  {
+    if (c.dictionary->Value(code).empty())
+    {
+      return false;
+    }
+    *ci = CodeColor(c, code);
+    return true;
+  }
+  auto &&s = logTrace_->GetItemValue(row, ColumnToDataItem(column));
+  if (s.empty())
+  {
+    return false;
+  }
+  // colors picked by the user win, then the palette of the most frequent
+  // values, nothing is stored for the rest
+  auto it = c.columnColor.find(s);
+  if (it != c.columnColor.end())
+  {
+    *ci = it->second;
+    return true;
+  }
+  auto fit = c.frequentColor.find(s);
+  ci->count = 0;
+  ci->index = 0;
+  ci->bgColor = fit != c.frequentColor.end() ? fit->second : HashColor(s);
+  ci->txtColor = UseWhiteText(ci->bgColor) ? RGB(0xFF, 0xFF, 0xFF) : 0;
+  return true;
+}
+
+ColorInfo *LogContext::EditableCellColor(int column, size_t row)
+{
+  ColorInfo current = {0};
+  if (!CellColor(column, row, &current))
+  {
+    return nullptr;
+  }
+  auto &c = *columns_[column];
+  uint32_t code = 0;
+  if (c.dictionary && c.dictionary->Code(row, &code))
+  {
+    return &CodeColor(c, code);
+  }
+  auto &chosen = c.columnColor[logTrace_->GetItemValue(row, ColumnToDataItem(column))];
+  if (chosen.bgColor == 0)
+  {
+    chosen = current;
+  }
+  return &chosen;
+}
+
+int LogContext::ColorCount(int column) const
+{
+  auto &c = *columns_[column];
+  return static_cast<int>(c.columnColor.size() + (c.dictionary ? c.dictionary->Size() : 0));
+}
+
+FilterSet LogContext::CurrentFilters() const
+{
+  FilterSet filters;
+  for (auto &c : columns_)
+  {
+    filters.push_back(c->GetFilter());
+  }
+  return filters;
+}
+
+void LogContext::RebuildViewIndex()
+{
+  if (!logTrace_)
+  {
+    return;
+  }
+  auto filters = CurrentFilters();
+  if (std::none_of(filters.begin(), filters.end(), [](const std::shared_ptr<const ColumnFilter> &f) { return f->IsActive(); }))
+  {
+    viewIndex_.AssignAll(filterId_, 0);
+  }
+  else
+  {
+    std::vector<size_t> rows;
+    size_t rowCount = 0;
+    if (!filterEngine_.CollectVisible(filterId_, &rows, &rowCount))
+    {
+      // FilterPassDone comes back here once the rows are known
+      if (!filterEngine_.HasPass(filterId_))
+      {
+        filterEngine_.Start(filterId_, filters, publishedRows_.load(std::memory_order_acquire));
+      }
+      return;
+    }
+    viewIndex_.Assign(filterId_, filters, std::move(rows), rowCount);
+  }
+  // rows that arrived while the pass was running
+  viewIndex_.Extend(*this, publishedRows_.load(std::memory_order_acquire));
+  // positions have moved, a selection would now point at other rows
+  ListView_SetItemState(listView_, -1, 0, LVIS_SELECTED);
+}
+
+size_t LogContext::ViewItemCount() const
+{
+  return hideNonMatching_ ? viewIndex_.Count() : publishedRows_.load(std::memory_order_acquire);
+}
+
+size_t LogContext::ViewToRow(size_t position) const
+{
+  return hideNonMatching_ ? viewIndex_.RowAt(position) : position;
+}
+
+void LogContext::RebuildMatchIndex()
+{
+  std::vector<size_t> rows;
+  size_t rowCount = 0;
+  if (!logTrace_ || !filterEngine_.CollectMatches(filterId_, &rows, &rowCount))
+  {
+    return;
+  }
+  auto filters = CurrentFilters();
+  const bool active = std::any_of(filters.begin(), filters.end(), [](const std::shared_ptr<const ColumnFilter> &f) { return f->IsActive(); });
+  matchIndex_.Assign(filterId_, filters, std::move(rows), rowCount);
+  matchIndex_.Extend(*this, publishedRows_.load(std::memory_order_acquire));
+  SetTitleStatus(active ? std::to_wstring(matchIndex_.Count()) + L" matches" : L"");
+}
+
+bool LogContext::RowToView(size_t row, size_t *position) const
+{
+  if (!hideNonMatching_)
+  {
+    *position = row;
+    return true;
+  }
+  return viewIndex_.PositionOf(row, position);
 }
 
 void LogContext::ResetView()
 {
+  if (CancelJob())
+  {
+    return;
+  }
   if(ResetViewNoInvalidate())
   {
     needRedraw_ = true;
@@ -540,21 +922,61 @@ bool LogContext::LoadPdbFromDialog()
 
 bool LogContext::ExportFromDialogAll()
 {
-  size_t count = 0;
-  return ExportFromDialog([this, &count](size_t *n)
+  if (!logTrace_)
+  {
+    return false;
+  }
+  ExportRows rows;
+  rows.all = true;
+  rows.rowCount = publishedRows_.load(std::memory_order_acquire);
+  return ExportFromDialog(rows, true);
+}
+
+bool LogContext::ExportFromDialogFiltered()
+{
+  if (!logTrace_)
+  {
+    return false;
+  }
+  ExportRows rows;
+  rows.all = true;
+  rows.rowCount = publishedRows_.load(std::memory_order_acquire);
+  rows.filter = std::make_shared<FilterEvaluator>(static_cast<const RowSource &>(*this), CurrentFilters());
+  return ExportFromDialog(rows, true);
+}
+
+bool LogContext::ExportFromDialogTimeRange()
+{
+  if (!logTrace_)
+  {
+    return false;
+  }
+  // every row from the earliest to the latest time of the selected rows
+  ExportRows rows;
+  rows.all = true;
+  rows.rowCount = publishedRows_.load(std::memory_order_acquire);
+  rows.fromTime = std::numeric_limits<uint64_t>::max();
+  for (size_t row : EnumerateRows(SelectedLinesEnumerator()))
   {
-    if (count < logTrace_->GetItemCount())
+    FILETIME ft;
+    if (GetRowTime(*logTrace_, row, &ft))
     {
-      *n = count++;
-      return true;
+      ULARGE_INTEGER t;
+      t.LowPart = ft.dwLowDateTime;
+      t.HighPart = ft.dwHighDateTime;
+      rows.fromTime = __min(rows.fromTime, t.QuadPart);
+      rows.toTime = __max(rows.toTime, t.QuadPart);
+      rows.timeRange = true;
     }
-    return false;
-  }, true);
+  }
+  return rows.timeRange && ExportFromDialog(rows, true);
 }
 
 bool LogContext::ExportFromDialogSelected()
 {
-  return ExportFromDialog(SelectedLinesEnumerator(), false);
+  ExportRows rows;
+  rows.listed = EnumerateRows(SelectedLinesEnumerator());
+  return ExportFromDialog(rows, false);
 }
 
 template <class StringT>
@@ -584,38 +1006,67 @@ bool CopyToClipboard(HWND owner, const StringT &txt)
 
 bool LogContext::CopySelected()
 {
-  std::wstring allLines;
-  ExtractTextLines(SelectedLinesEnumerator(),
-                   [&allLines](const std::wstring &txt)
-                   {
-                     allLines += txt;
-                     return true;
-                   }, false);
-  return !allLines.empty() && CopyToClipboard(mainWindow_, allLines);
-}
-
-bool LogContext::ExportFromDialog(const std::function<bool (size_t *n)> &enumerator, bool includeHeader)
-{
-  if (FileSaveDialog(L"Text File (*.txt;*.log)\0*.txt;*.log\0\0",
-    [this, enumerator, includeHeader](const fs::path &filePath)
+  ExportRows rows;
+  rows.listed = EnumerateRows(SelectedLinesEnumerator());
+  if (rows.listed.empty())
   {
-    if (!fs::exists(filePath.parent_path()))
+    return false;
+  }
+  auto exporter = std::make_shared<TextExporter>(*logTrace_, ExportFields(ColumnCount()));
+  return StartJob(L"copy", [this, exporter, rows]()
+  {
+    TrackJob(*exporter);
+    std::string text;
+    if (!exporter->Write([&text](const std::string &block)
     {
-      fs::create_directories(filePath.parent_path());
-    }
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> converter;
-    auto fh = _wfopen(filePath.c_str(), L"wb");
-    if (!fh)
+      text += block;
+      return true;
+    }, rows))
     {
       return false;
     }
-    const bool rv = ExtractTextLines(enumerator, [&converter, fh](const std::wstring &txt)
-    {
-      std::string tmp = converter.to_bytes(txt);
-      return fwrite(tmp.c_str(), 1, tmp.length(), fh) == tmp.length();
-    }, includeHeader);
-    fclose(fh);
-    return rv;
+    DecodeUtf8(text.data(), text.length(), &jobClipboard_);
+    return true;
+  });
+}
+
+bool LogContext::ExportFromDialog(ExportRows rows, bool includeHeader)
+{
+  if (!logTrace_)
+  {
+    return false;
+  }
+  if (FileSaveDialog(L"Text File (*.txt;*.log)\0*.txt;*.log\0CSV File (*.csv)\0*.csv\0JSON Lines (*.jsonl)\0*.jsonl\0"
+                     L"etrace Snapshot (*.etrace)\0*.etrace\0\0",
+    [this, &rows, includeHeader](const fs::path &filePath)
+  {
+    if (!fs::exists(filePath.parent_path()))
+    {
+      fs::create_directories(filePath.parent_path());
+    }
+    if (filePath.extension() == ".etrace")
+    {
+      return SaveSnapshot(rows, filePath);
+    }
+    auto exporter = std::make_shared<TextExporter>(*logTrace_, ExportFields(ColumnCount()), ExportFormatOf(filePath));
+    exporter->IncludeHeader(includeHeader);
+    return StartJob(L"export", [this, exporter, rows, filePath]()
+    {
+      TrackJob(*exporter);
+      auto fh = _wfopen(filePath.c_str(), L"wb");
+      if (!fh)
+      {
+        return false;
+      }
+      const bool rv = exporter->Write(fh, rows);
+      fclose(fh);
+      if (!rv && cancelJob_)
+      {
+        std::error_code ec;
+        fs::remove(filePath, ec);
+      }
+      return rv;
+    });
   }, 0, sessionName_ + L".log"))
   {
     InvalidateView(LVSICF_NOSCROLL);
@@ -624,48 +1075,96 @@ bool LogContext::ExportFromDialog(const std::function<bool (size_t *n)> &enumera
   return false;
 }
 
-bool LogContext::ExtractTextLines(const std::function<bool(size_t *n)> &enumerator,
-                                  const std::function<bool(const std::wstring &txt)> &output,
-                                  bool includeHeader)
+bool LogContext::SaveSnapshot(const ExportRows &rows, const fs::path &filePath)
 {
-  if (includeHeader)
+  // colors in use, by value, the codes of a dictionary are not kept
+  std::vector<SnapshotColor> colors;
+  for (int column = 0; column < ColumnCount(); ++column)
   {
-    std::wstring txt;
-    for (int c = 0; c < ColumnCount(); ++c)
+    auto &c = *columns_[column];
+    const auto item = ColumnToDataItem(column);
+    for (auto &&cc : c.columnColor)
     {
-      if (!txt.empty())
+      if (cc.second.bgColor != 0)
       {
-        txt += L'\t';
+        colors.push_back({item, cc.first, cc.second.index, cc.second.bgColor, cc.second.txtColor});
       }
-      txt += columnNames[c];
     }
-    etl::TrimR(txt) += L"\r\n";
-    output(txt);
-  }
-  size_t i = std::numeric_limits<size_t>::max();
-  while (enumerator(&i))
-  {
-    std::wstring txt;
-    for (int c = 0; c < ColumnCount(); ++c)
+    for (size_t code = 0; c.dictionary && code < c.codeColor.size(); ++code)
     {
-      if (!txt.empty())
+      auto &&ci = c.codeColor[code];
+      if (ci.bgColor != 0)
       {
-        txt += L'\t';
+        colors.push_back({item, c.dictionary->Value(static_cast<uint32_t>(code)), ci.index, ci.bgColor, ci.txtColor});
       }
-      txt += logTrace_->GetItemValue(i, ColumnToDataItem(c));
     }
-    etl::TrimR(txt) += L"\r\n";
-    if (!output(txt))
+  }
+  // groups change on the UI thread, the job writes them as they are now
+  size_t groupRows = rows.rowCount;
+  for (auto row : rows.listed)
+  {
+    groupRows = __max(groupRows, row + 1);
+  }
+  auto groupIds = std::make_shared<std::vector<int>>(groupRows);
+  for (size_t row = 0; row < groupRows; ++row)
+  {
+    (*groupIds)[row] = rowState_.GroupId(row);
+  }
+  return StartJob(L"snapshot", [this, rows, colors, groupIds, filePath]()
+  {
+    SnapshotWriter writer(*logTrace_, SelectExportRows(*logTrace_, rows));
+    TrackJob(writer);
+    writer.SetGroupIds(std::move(*groupIds));
+    for (auto &&color : colors)
     {
+      writer.AddColor(color);
+    }
+    const bool rv = !cancelJob_ && writer.Write(filePath);
+    // the file of a cancelled job is not kept
+    if (cancelJob_)
+    {
+      std::error_code ec;
+      fs::remove(filePath, ec);
       return false;
     }
+    return rv;
+  });
+}
+
+void LogContext::RestoreSnapshotState(const SnapshotStore &snapshot)
+{
+  for (size_t row = 0; row < snapshot.GetItemCount(); ++row)
+  {
+    const int groupId = snapshot.GroupId(row);
+    if (groupId > 0)
+    {
+      rowState_.SetGroupId(row, groupId);
+      groupCounter_ = __max(groupCounter_, groupId);
+    }
+  }
+  for (auto &&color : snapshot.Colors())
+  {
+    const int column = DataItemToColumn(color.item);
+    if (column < 0 || column >= ColumnCount())
+    {
+      continue;
+    }
+    auto &c = *columns_[column];
+    const ColorInfo ci = {0, color.index, color.bgColor, color.txtColor};
+    if (c.dictionary)
+    {
+      c.savedCodeColor[color.value] = ci;
+    }
+    else
+    {
+      c.columnColor[color.value] = ci;
+    }
   }
-  return true;
 }
 
 bool LogContext::LoadEtlFromDialog()
 {
-  if(FileOpenDialog(L"Event Trace Log Files\0*.etl;*.log\0\0",
+  if(FileOpenDialog(L"Event Trace Log Files\0*.etl;*.log;*.etrace\0\0",
                     [this](const fs::path &filePath)
                     {
                       return LoadEventLogFile(filePath);
@@ -688,56 +1187,25 @@ bool LogContext::BeginTrace()
   {
     return false;
   }
-  for (int column = 0; column < ColumnCount(); ++column)
-  {
-    colorFilters_.push_back(std::make_pair([this, column](int col, const std::wstring &val) -> bool {
-      return col == column && !val.empty() ? !FilterColumn(ColumnToDataItem(col), val) : false;
-    }, 0.37f));
-  }
   logTrace_->SetCountCallback([this](size_t itemCount)
   {
-    if (itemCount > 0)
-    {
-      const auto lineNo = itemCount - 1;
-      InitializeRowContext(lineNo);
-      size_t totalMaxLength = 0;
-      for (int i = 1; i < _countof(columnNames); ++i)
-      {
-        auto item = ColumnToDataItem(i);
-        if (item != etl::TraceEventDataItem::MAX_ITEM)
-        {
-          auto &&s = logTrace_->GetItemValue(lineNo, item);
-          auto &procCol = columns_[i]->columnColor[s];
-          columns_[i]->longestTextLength_ = __max(columns_[i]->longestTextLength_, s.length());
-          totalMaxLength += columns_[i]->longestTextLength_;
-          if (procCol.count++ == 0)
-          {
-            procCol.index = columns_[i]->columnColor.size();
-            procCol.bgColor = 0;
-          }
-        }
-      }
-      if (totalMaxLength > 0)
-      {
-        auto maxL = totalMaxLength;
-        for (int i = 0; i < _countof(columnNames); ++i)
-        {
-          auto l = __max(10, columns_[i]->longestTextLength_);
-          l = __min(l, maxL);
-          maxL -= l;
-          columns_[i]->sizeRatio = static_cast<float>(l) / totalMaxLength;
-        }
-        RepositionControls();
-      }
-    }
-    DWORD flags = LVSICF_NOINVALIDATEALL;
-    if (needRedraw_)
+    // the ingest thread reports once per drained queue
+    if (!injecting_)
     {
-      flags = 0;
-      needRedraw_ = false;
+      RowsArrived(itemCount);
     }
-    ListView_SetItemCountEx(listView_, itemCount, LVSICF_NOSCROLL | flags);
   });
+  SetTimer(mainWindow_, IDT_VIEWREFRESH, viewRefreshMs, nullptr);
+  if (!filterEngine_.HasPass(filterId_))
+  {
+    // gives the indexes a starting point after the rows were reset
+    filterEngine_.Start(filterId_, CurrentFilters(), publishedRows_.load(std::memory_order_acquire));
+  }
+  if (hideNonMatching_)
+  {
+    RebuildViewIndex();
+  }
+  StartIngest();
   bool rv = logTrace_->Start();
   if (rv)
   {
@@ -750,6 +1218,45 @@ bool LogContext::BeginTrace()
   return rv;
 }
 
+void LogContext::RowsArrived(size_t itemCount)
+{
+  // runs for every event or batch, the view is left to RefreshView
+  std::lock_guard<std::mutex> l(rowsLock_);
+  for (int i = 1; i < _countof(columnNames); ++i)
+  {
+    auto item = ColumnToDataItem(i);
+    if (item != etl::TraceEventDataItem::MAX_ITEM)
+    {
+      auto &column = *columns_[i];
+      const auto longest = column.longestTextLength_;
+      if (!CodeRows(column, item, itemCount))
+      {
+        const size_t newRows = itemCount > countedRows_ ? itemCount - countedRows_ : 0;
+        const size_t step = sampleStats_ ? __max(newRows / statsSampleRows, 1) : 1;
+        for (auto row = countedRows_; row < itemCount; row += step)
+        {
+          auto &&s = logTrace_->GetItemValue(row, item);
+          column.stats.Add(s);
+          column.longestTextLength_ = __max(column.longestTextLength_, s.length());
+        }
+      }
+      if (column.longestTextLength_ != longest)
+      {
+        viewUpdates_.LayoutChanged();
+      }
+    }
+  }
+  countedRows_ = __max(countedRows_, itemCount);
+  matchIndex_.Extend(*this, itemCount);
+  if (hideNonMatching_)
+  {
+    viewIndex_.Extend(*this, itemCount);
+  }
+  // rows become visible to the UI only once everything above has seen them
+  publishedRows_.store(countedRows_, std::memory_order_release);
+  viewUpdates_.RowsAdded(itemCount);
+}
+
 void LogContext::SetComPort(const std::wstring &comPort)
 {
   comPort_ = comPort;
@@ -760,6 +1267,11 @@ void LogContext::SetBaudRate(int baudRate)
   baudRate_ = baudRate;
 }
 
+bool LogContext::SetComFormats(const fs::path &formatsPath)
+{
+  return comFormats_.Load(formatsPath);
+}
+
 void LogContext::StopCom()
 {
   runComThread_ = false;
@@ -789,170 +1301,373 @@ void LogContext::ReloadAllPdbs()
   }
 }
 
-void LogContext::GotoMatch(int dir)
+void LogContext::FilterPassDone(int generation)
+{
+  // rows painted while the pass was running were evaluated one by one,
+  // repaint so the rest picks up the finished results
+  if (generation == filterId_)
+  {
+    RebuildMatchIndex();
+    if (hideNonMatching_)
+    {
+      RebuildViewIndex();
+    }
+    InvalidateView(LVSICF_NOSCROLL);
+  }
+}
+
+void LogContext::SetTitleStatus(const std::wstring &status)
+{
+  SetWindowTextW(mainWindow_, status.empty() ? windowTitle_.c_str() : (windowTitle_ + L" - " + status).c_str());
+}
+
+void LogContext::FilterProgress(int generation, int percent)
+{
+  if (generation == filterId_)
+  {
+    SetTitleStatus(L"filtering " + std::to_wstring(percent) + L"%");
+  }
+}
+
+bool LogContext::StartJob(const std::wstring &name, const std::function<bool()> &job)
+{
+  if (jobThread_)
+  {
+    SetTitleStatus(jobName_ + L" still running, Esc cancels");
+    return false;
+  }
+  ++jobId_;
+  jobName_ = name;
+  cancelJob_ = false;
+  jobDoneRows_ = 0;
+  jobTotalRows_ = 0;
+  jobStart_ = std::chrono::steady_clock::now();
+  jobClipboard_.clear();
+  SetTitleStatus(name + L" started, Esc cancels");
+  jobThread_ = std::make_unique<std::thread>([this, job, id = jobId_]()
+  {
+    const bool ok = job();
+    PostMessageW(mainWindow_, WM_JOBDONE, id, ok ? 1 : 0);
+  });
+  return true;
+}
+
+void LogContext::TrackJob(TextExporter &exporter)
+{
+  exporter.SetCancelFlag(&cancelJob_);
+  exporter.SetProgressCallback(JobProgressCallback());
+}
+
+void LogContext::TrackJob(SnapshotWriter &writer)
+{
+  writer.SetCancelFlag(&cancelJob_);
+  writer.SetProgressCallback(JobProgressCallback());
+}
+
+std::function<void(size_t doneRows, size_t totalRows)> LogContext::JobProgressCallback()
+{
+  return [this, id = jobId_](size_t doneRows, size_t totalRows)
+  {
+    jobTotalRows_ = totalRows;
+    const size_t before = jobDoneRows_.exchange(doneRows);
+    // one message per percent is plenty
+    if (doneRows * 100 / totalRows != before * 100 / totalRows)
+    {
+      PostMessageW(mainWindow_, WM_JOBPROGRESS, id, 0);
+    }
+  };
+}
+
+bool LogContext::CancelJob()
+{
+  if (!jobThread_)
+  {
+    return false;
+  }
+  cancelJob_ = true;
+  SetTitleStatus(jobName_ + L" cancelling");
+  return true;
+}
+
+void LogContext::StopJob()
+{
+  if (!jobThread_)
+  {
+    return;
+  }
+  cancelJob_ = true;
+  jobThread_->join();
+  jobThread_.reset();
+  // the messages the job posted are of an old job id by now
+  ++jobId_;
+  SetTitleStatus(jobName_ + L" cancelled");
+}
+
+void LogContext::JobProgress(int job)
+{
+  if (job != jobId_ || !jobThread_ || cancelJob_ || jobTotalRows_ == 0)
+  {
+    return;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - jobStart_).count();
+  const size_t doneRows = jobDoneRows_;
+  SetTitleStatus(jobName_ + L" " + std::to_wstring(doneRows * 100 / jobTotalRows_) + L"%, " +
+                 std::to_wstring(static_cast<size_t>(doneRows / __max(seconds, 0.001))) + L" rows/s, Esc cancels");
+}
+
+void LogContext::JobDone(int job, bool ok)
+{
+  if (job != jobId_ || !jobThread_)
+  {
+    return;
+  }
+  jobThread_->join();
+  jobThread_.reset();
+  std::wstring clipboard;
+  clipboard.swap(jobClipboard_);
+  if (cancelJob_)
+  {
+    SetTitleStatus(jobName_ + L" cancelled");
+    return;
+  }
+  if (!ok || (!clipboard.empty() && !CopyToClipboard(mainWindow_, clipboard)))
+  {
+    SetTitleStatus(jobName_ + L" failed");
+    return;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - jobStart_).count();
+  std::wstring status = jobName_ + L" done";
+  if (jobTotalRows_ != 0)
+  {
+    status += L", " + std::to_wstring(jobTotalRows_.load()) + L" rows at " +
+              std::to_wstring(static_cast<size_t>(jobTotalRows_ / __max(seconds, 0.001))) + L" rows/s";
+  }
+  SetTitleStatus(status);
+}
+
+void LogContext::ScheduleFilters()
+{
+  // keystrokes are coalesced, filtering starts once typing pauses and a
+  // newer pass cancels whatever is left of the previous one
+  filterDebounce_.Request();
+  SetTimer(mainWindow_, IDT_FILTERDEBOUNCE, filterDelayMs, nullptr);
+}
+
+void LogContext::FilterTimer()
+{
+  if (filterDebounce_.Fire())
+  {
+    ApplyFilters();
+  }
+  else if (filterDebounce_.IsPending())
+  {
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(filterDebounce_.Remaining());
+    SetTimer(mainWindow_, IDT_FILTERDEBOUNCE, static_cast<UINT>(remaining.count()) + 1, nullptr);
+  }
+  else
+  {
+    KillTimer(mainWindow_, IDT_FILTERDEBOUNCE);
+  }
+}
+
+void LogContext::ToggleHideNonMatching()
 {
-  auto ri = currentMatchingLine_ + dir;
-  size_t testCount = 0;
-  bool found = false;
-  do
   {
-    if (ri >= static_cast<int>(logTrace_->GetItemCount()))
+    // a batch counted before the flip is below the count the rebuild
+    // extends to, a batch counted after it extends the index itself
+    std::lock_guard<std::mutex> l(rowsLock_);
+    hideNonMatching_ = !hideNonMatching_;
+  }
+  CheckMenuItem(GetMenu(mainWindow_), ID_VIEW_HIDENONMATCHING, MF_BYCOMMAND | (hideNonMatching_ ? MF_CHECKED : MF_UNCHECKED));
+  if (!logTrace_)
+  {
+    return;
+  }
+  if (hideNonMatching_)
+  {
+    RebuildViewIndex();
+  }
+  else
+  {
+    viewIndex_.Clear();
+    ListView_SetItemState(listView_, -1, 0, LVIS_SELECTED);
+  }
+  InvalidateView(0);
+  size_t position = 0;
+  if (currentMatchingLine_ != noMatchingLine && RowToView(currentMatchingLine_, &position))
+  {
+    ListView_EnsureVisible(listView_, static_cast<int>(position), FALSE);
+  }
+}
+
+bool LogContext::FindMatch(int dir, size_t *match, size_t *row) const
+{
+  // rows hidden from the view are skipped, they are still counted
+  const auto count = matchIndex_.Count();
+  if (count == 0)
+  {
+    return false;
+  }
+  size_t k = 0;
+  if (currentMatchingLine_ == noMatchingLine)
+  {
+    k = dir > 0 ? 0 : count - 1;
+  }
+  else if (matchIndex_.PositionOf(currentMatchingLine_, &k))
+  {
+    k = (k + count + dir) % count;
+  }
+  else
+  {
+    // the current row has no match anymore, k is where it would be
+    k = dir > 0 ? k % count : (k + count - 1) % count;
+  }
+  for (size_t tries = 0; tries < count; ++tries)
+  {
+    size_t position = 0;
+    *row = matchIndex_.RowAt(k);
+    if (RowToView(*row, &position))
+    {
+      *match = k;
+      return true;
+    }
+    k = (k + count + dir) % count;
+  }
+  return false;
+}
+
+bool LogContext::ScanForMatch(int dir, size_t *row) const
+{
+  // walks list view positions, currentMatchingLine_ holds the row
+  const auto count = ViewItemCount();
+  int ri = dir > 0 ? 0 : -1;
+  size_t position = 0;
+  if (currentMatchingLine_ != noMatchingLine)
+  {
+    if (RowToView(currentMatchingLine_, &position))
+    {
+      ri = static_cast<int>(position) + dir;
+    }
+    else
+    {
+      // the row got hidden, position is where it would have been
+      ri = static_cast<int>(position) + (dir > 0 ? 0 : dir);
+    }
+  }
+  for (size_t testCount = 0; testCount < count; ++testCount, ri += dir)
+  {
+    if (ri >= static_cast<int>(count))
     {
       ri = 0;
     }
     if (ri < 0)
     {
-      ri = static_cast<int>(logTrace_->GetItemCount()) - 1;
+      ri = static_cast<int>(count) - 1;
     }
+    *row = ViewToRow(ri);
     for (auto eti = etl::TraceEventDataItem::TraceIndex; eti < etl::TraceEventDataItem::MAX_ITEM; ++eti)
     {
-      if (FilterColumn(eti, logTrace_->GetItemValue(ri, eti), false))
+      if (FilterColumn(eti, logTrace_->GetItemValue(*row, eti), false))
       {
-        found = true;
-        break;
+        return true;
       }
     }
-    if (!found)
-    {
-      ri += dir;
-      ++testCount;
-    }
-  } while (!found && testCount < logTrace_->GetItemCount());
-  //
-  if (found)
+  }
+  return false;
+}
+
+void LogContext::GotoMatch(int dir)
+{
+  if (!logTrace_)
   {
-    const auto old = currentMatchingLine_;
-    currentMatchingLine_ = ri;
-    ListView_EnsureVisible(listView_, currentMatchingLine_, FALSE);
-    const auto topIndex = ListView_GetTopIndex(listView_);
-    RECT topRect = {0};
-    ListView_GetItemRect(listView_, topIndex, &topRect, LVIR_BOUNDS);
-    RECT foundRect = {0};
-    ListView_GetItemRect(listView_, currentMatchingLine_, &foundRect, LVIR_BOUNDS);
-    const int dy = foundRect.top - topRect.top;
-    ListView_Scroll(listView_, 0, dy);
-    ListView_Update(listView_, currentMatchingLine_);
-    ListView_Update(listView_, old);
+    return;
+  }
+  size_t row = 0;
+  size_t match = 0;
+  // the index lags behind until the pass of the current filters is done
+  const bool indexed = matchIndex_.Generation() == filterId_;
+  if (indexed ? !FindMatch(dir, &match, &row) : !ScanForMatch(dir, &row))
+  {
+    return;
+  }
+  size_t position = 0;
+  int oldPos = -1;
+  if (currentMatchingLine_ != noMatchingLine && RowToView(currentMatchingLine_, &position))
+  {
+    oldPos = static_cast<int>(position);
+  }
+  RowToView(row, &position);
+  const int ri = static_cast<int>(position);
+  currentMatchingLine_ = row;
+  ListView_EnsureVisible(listView_, ri, FALSE);
+  const auto topIndex = ListView_GetTopIndex(listView_);
+  RECT topRect = {0};
+  ListView_GetItemRect(listView_, topIndex, &topRect, LVIR_BOUNDS);
+  RECT foundRect = {0};
+  ListView_GetItemRect(listView_, ri, &foundRect, LVIR_BOUNDS);
+  const int dy = foundRect.top - topRect.top;
+  ListView_Scroll(listView_, 0, dy);
+  ListView_Update(listView_, ri);
+  ListView_Update(listView_, oldPos);
+  if (indexed)
+  {
+    SetTitleStatus(L"match " + std::to_wstring(match + 1) + L" of " + std::to_wstring(matchIndex_.Count()));
   }
 }
 
 bool LogContext::StartCom()
 {
-  enum class ComState {Connecting, RequestData, WaitForData, ConsumeData};
+  runComThread_ = true;
   comThread_ = std::make_unique<std::thread>([this]()
   {
-    runComThread_ = true;
-    OVERLAPPED ov = { 0 };
-    ov.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-    char tmp[2000];
-    DWORD bytesRead = 0;
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> converter;
-    ComState state = ComState::Connecting;
-    HANDLE h = INVALID_HANDLE_VALUE;
-    std::wstring keepString;
-    while (runComThread_)
-    {
-      if (state == ComState::Connecting)
-      {
-        if (h != INVALID_HANDLE_VALUE)
-        {
-          CloseHandle(h);
-        }
-        h = CreateFileW(comPort_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
-        if (h != INVALID_HANDLE_VALUE)
-        {
-          DCB dcb = { 0 };
-          dcb.DCBlength = sizeof(DCB);
-          if (GetCommState(h, &dcb))
-          {
-            dcb.BaudRate = baudRate_;
-            dcb.ByteSize = 8;
-            dcb.Parity = 0;
-            dcb.StopBits = 0;
-            dcb.fBinary = 1;
-            if (SetCommState(h, &dcb))
-            {
-              state = ComState::RequestData;
-            }
-          }
-        }
-        if (state == ComState::Connecting)
-        {
-          Sleep(500);
-        }
-      }
-      if (state == ComState::RequestData)
-      {
-        if (ReadFile(h, tmp, sizeof(tmp), &bytesRead, &ov))
-        {
-          state = ComState::ConsumeData;
-        }
-        else if (GetLastError() == ERROR_IO_PENDING)
-        {
-          state = ComState::WaitForData;
-        }
-        else
-        {
-          std::wstringstream ss;
-          ss << L"ReadFile ERROR: " << GetLastError();
-          InsertText(ss.str());
-          state = ComState::Connecting;
-        }
-      }
-      if (state == ComState::WaitForData)
+    // with a format table the device sends binary records instead of text
+    const bool binary = !comFormats_.IsEmpty();
+    SerialReader reader(CreateSerialTransport(), comPort_, baudRate_, binary ? '\0' : '\n');
+    BinaryTraceDecoder decoder(comFormats_);
+    // local time of the first binary record, the others follow the device clock
+    FILETIME firstRecordTime = { 0 };
+    bool haveFirstRecord = false;
+    const auto portName = comPort_.substr(4);
+    reader.Run(runComThread_, [&](const std::vector<SerialReader::Line> &lines)
+    {
+      const auto timeStamp = etl::GetCurrentLocalFileTime();
+      auto batch = std::make_unique<TextBatch>();
+      batch->SetShared(etl::TraceEventDataItem::ModuleName, portName);
+      for (auto &&l : lines)
       {
-        auto wait = WaitForSingleObject(ov.hEvent, 500);
-        if (wait == 0)
+        if (!binary)
         {
-          if (GetOverlappedResult(h, &ov, &bytesRead, FALSE))
-          {
-            state = ComState::ConsumeData;
-          }
-          else
-          {
-            std::wstringstream ss;
-            ss << L"GetOverlappedResult ERROR: " << GetLastError();
-            InsertText(ss.str());
-            state = ComState::Connecting;
-          }
+          batch->AddRecord(timeStamp);
+          batch->SetAsciiValue(etl::TraceEventDataItem::Message, l.text, l.length);
+          continue;
         }
-      }
-      if(state == ComState::ConsumeData)
-      {
-        for (DWORD i = 0; i < bytesRead; ++i)
+        if (!decoder.Decode(l.text, l.length))
         {
-          if ((tmp[i] & 0x80) != 0)
-          {
-            tmp[i] = '?';
-          }
+          batch->AddRecord(timeStamp);
+          batch->SetValue(etl::TraceEventDataItem::Message, L"broken record, " + std::to_wstring(l.length) + L" bytes");
+          continue;
         }
-        std::wstring str = keepString;
-        str += converter.from_bytes(tmp, tmp + bytesRead);
-        keepString.clear();
-        auto sv = etl::Split(str, L'\n');
-        if (str.length() > 0 && str.back() != L'\n')
+        if (!haveFirstRecord)
         {
-          keepString = sv.back();
-          sv.pop_back();
+          firstRecordTime = timeStamp;
+          haveFirstRecord = true;
         }
-        auto timeStamp = etl::GetCurrentLocalFileTime();
-        std::map<etl::TraceEventDataItem, std::wstring> txtMap{ {etl::TraceEventDataItem::ModuleName, comPort_.substr(4)} };
-        for (auto &&s : sv)
+        batch->AddRecord(AddMicroseconds(firstRecordTime, decoder.Time()));
+        if (auto format = decoder.Format())
         {
-          etl::TrimR(s);
-          if (s.length() > 0)
-          {
-            txtMap[etl::TraceEventDataItem::Message] = s;
-            InsertText(timeStamp, txtMap);
-          }
+          batch->SetValue(etl::TraceEventDataItem::SourceFile, format->File());
+          batch->SetValue(etl::TraceEventDataItem::Function, format->Function());
         }
-        state = ComState::RequestData;
+        batch->SetValue(etl::TraceEventDataItem::Message, decoder.Text());
       }
-    }
-    if (h != INVALID_HANDLE_VALUE)
+      Ingest(std::move(batch));
+    }, [&](const std::wstring &message)
     {
-      CloseHandle(h);
-    }
+      // the device may have restarted its clock
+      decoder.Reset();
+      haveFirstRecord = false;
+      InsertText(message);
+    });
   });
   return true;
 }
@@ -964,10 +1679,59 @@ void LogContext::EndTrace()
   {
     comThread_->join();
   }
+  StopIngest();
+  filterEngine_.Stop();
   if(logTrace_)
   {
     logTrace_->Stop();
   }
+  KillTimer(mainWindow_, IDT_VIEWREFRESH);
+  // rows that came in since the last tick, Take only reports changes so
+  // this never repeats an update
+  RefreshView();
+}
+
+void LogContext::RefreshView()
+{
+  UpdateCoalescer::Update update = {};
+  const bool changed = viewUpdates_.Take(&update);
+  const bool redraw = needRedraw_.exchange(false);
+  if (!changed && !redraw)
+  {
+    return;
+  }
+  if (update.layoutChanged)
+  {
+    UpdateColumnRatios();
+  }
+  DWORD flags = LVSICF_NOINVALIDATEALL;
+  if (redraw)
+  {
+    flags = 0;
+  }
+  InvalidateView(LVSICF_NOSCROLL | flags);
+}
+
+void LogContext::UpdateColumnRatios()
+{
+  size_t totalMaxLength = 0;
+  for (int i = 1; i < _countof(columnNames); ++i)
+  {
+    totalMaxLength += columns_[i]->longestTextLength_;
+  }
+  if (totalMaxLength == 0)
+  {
+    return;
+  }
+  auto maxL = totalMaxLength;
+  for (int i = 0; i < _countof(columnNames); ++i)
+  {
+    auto l = __max(10, columns_[i]->longestTextLength_);
+    l = __min(l, maxL);
+    maxL -= l;
+    columns_[i]->sizeRatio = static_cast<float>(l) / totalMaxLength;
+  }
+  RepositionControls();
 }
 
 void LogContext::ActivateColumn(NMLISTVIEW * listViewInfo)
@@ -979,17 +1743,40 @@ void LogContext::ActivateColumn(NMLISTVIEW * listViewInfo)
   auto &colInfo = columns_[listViewInfo->iSubItem]->columnColor;
   if (selectedColumn_ != listViewInfo->iSubItem)
   {
+    const auto colorCount = ColorCount(listViewInfo->iSubItem);
     for (auto &cc : colInfo)
     {
       if (cc.second.bgColor == 0)
       {
-        cc.second.bgColor = GenerateColor(cc.second.index, colInfo.size());
+        cc.second.bgColor = GenerateColor(cc.second.index, colorCount);
         if (UseWhiteText(cc.second.bgColor))
         {
           cc.second.txtColor = RGB(0xFF, 0xFF, 0xFF);
         }
       }
     }
+    auto &column = *columns_[listViewInfo->iSubItem];
+    column.frequentColor.clear();
+    const auto top = column.stats.Top(frequentValueColors);
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+      column.frequentColor[top[i].value] = GenerateColor(static_cast<int>(i), static_cast<int>(top.size()));
+    }
+    if (column.dictionary && column.dictionary->Size() > 0)
+    {
+      CodeColor(column, static_cast<uint32_t>(column.dictionary->Size() - 1));
+      for (auto &cc : column.codeColor)
+      {
+        if (cc.bgColor == 0)
+        {
+          cc.bgColor = GenerateColor(cc.index, colorCount);
+          if (UseWhiteText(cc.bgColor))
+          {
+            cc.txtColor = RGB(0xFF, 0xFF, 0xFF);
+          }
+        }
+      }
+    }
     selectedColumn_ = listViewInfo->iSubItem;
   }
   else
@@ -1005,10 +1792,17 @@ void LogContext::SetItemText(NMLVDISPINFOW *plvdi)
   {
     return;
   }
-  plvdi->item.pszText = const_cast<LPWSTR>(logTrace_->GetItemValue(plvdi->item.iItem, ColumnToDataItem(plvdi->item.iSubItem), nullptr));
+  const auto row = ViewToRow(plvdi->item.iItem);
+  if (row >= publishedRows_.load(std::memory_order_acquire))
+  {
+    // the view can briefly ask for positions the index no longer has
+    plvdi->item.pszText = const_cast<LPWSTR>(L"");
+    return;
+  }
+  plvdi->item.pszText = const_cast<LPWSTR>(logTrace_->GetItemValue(row, ColumnToDataItem(plvdi->item.iSubItem), nullptr));
 }
 
-bool LogContext::SetItemColorFromColumn(NMLVCUSTOMDRAW *lvd)
+bool LogContext::SetItemColorFromColumn(NMLVCUSTOMDRAW *lvd, size_t row)
 {
   if (selectedColumn_ < 0)
   {
@@ -1017,29 +1811,23 @@ bool LogContext::SetItemColorFromColumn(NMLVCUSTOMDRAW *lvd)
   ColorInfo ci = { 0 };
   if (selectedColumn_ == 0)
   {
-    auto rc = GetRowContext(lvd->nmcd.dwItemSpec);
-    if (!rc)
-    {
-      return false;
-    }
-    if (rc->groupId <= 0)
+    const auto groupId = rowState_.GroupId(row);
+    if (groupId <= 0)
     {
       return false;
     }
-    ci = columns_[selectedColumn_]->columnColor[std::to_wstring(rc->groupId)];
+    ci = columns_[selectedColumn_]->columnColor[std::to_wstring(groupId)];
   }
   else
   {
-    auto &&s = logTrace_->GetItemValue(lvd->nmcd.dwItemSpec, ColumnToDataItem(selectedColumn_));
-    if (s.empty())
+    if (!CellColor(selectedColumn_, row, &ci))
     {
       return false;
     }
-    ci = columns_[selectedColumn_]->columnColor[s];
   }
   if (ci.bgColor == 0)
   {
-    ci.bgColor = GenerateColor(ci.index, columns_[selectedColumn_]->columnColor.size());
+    ci.bgColor = GenerateColor(ci.index, ColorCount(selectedColumn_));
     if (UseWhiteText(ci.bgColor))
     {
       ci.txtColor = RGB(0xFF, 0xFF, 0xFF);
@@ -1056,26 +1844,27 @@ void LogContext::SetItemColors(NMLVCUSTOMDRAW *lvd)
   {
     return;
   }
+  const auto row = ViewToRow(lvd->nmcd.dwItemSpec);
+  if (row >= publishedRows_.load(std::memory_order_acquire))
+  {
+    return;
+  }
   lvd->clrTextBk = RGB(0xFF, 0xFF, 0xFF);
   lvd->clrText = RGB(0, 0, 0);
-  SetItemColorFromColumn(lvd);
-  auto colPair = reinterpret_cast<RowContext *>(logTrace_->GetItemMetadata(lvd->nmcd.dwItemSpec));
-  if (!colPair)
+  SetItemColorFromColumn(lvd, row);
+  if (rowState_.LastFilterCount(row) != filterId_)
   {
-    InitializeRowContext(lvd->nmcd.dwItemSpec);
-    colPair = reinterpret_cast<RowContext *>(logTrace_->GetItemMetadata(lvd->nmcd.dwItemSpec));
+    // painted outside of the range prepared by UpdateVisibleFades
+    UpdateFades(lvd->nmcd.dwItemSpec, lvd->nmcd.dwItemSpec + 1);
   }
-  if (currentMatchingLine_ == lvd->nmcd.dwItemSpec)
+  if (currentMatchingLine_ == row)
   {
     //lvd->clrTextBk = RGB(0x77, 0xFF, 0xFF);
     std::swap(lvd->clrText, lvd->clrTextBk);
   }
-  if (colPair->lastFilterCount != filterId_)
-  {
-    colPair->colorFade = GetFilterLineFade(lvd->nmcd.dwItemSpec);
-  }
-  lvd->clrTextBk = ColorLerp(0x00FFFFFF, lvd->clrTextBk, colPair->colorFade);
-  lvd->clrText = ColorLerp(0x00FFFFFF, lvd->clrText, colPair->colorFade);
+  const auto colorFade = rowState_.ColorFade(row);
+  lvd->clrTextBk = ColorLerp(0x00FFFFFF, lvd->clrTextBk, colorFade);
+  lvd->clrText = ColorLerp(0x00FFFFFF, lvd->clrText, colorFade);
 }
 
 void LogContext::HandleContextMenu()
@@ -1102,14 +1891,10 @@ void LogContext::HandleContextMenu()
     // reuse a group id if there is one within the selection
     while (enumerator(&n))
     {
-      auto rc = GetRowContext(n);
-      if (rc)
+      if (rowState_.GroupId(n) > 0)
       {
-        if (rc->groupId > 0)
-        {
-          groupId = rc->groupId;
-          break;
-        }
+        groupId = rowState_.GroupId(n);
+        break;
       }
     }
     // create a new otherwise
@@ -1120,11 +1905,7 @@ void LogContext::HandleContextMenu()
     n = std::numeric_limits<size_t>::max();
     while (enumerator(&n))
     {
-      auto rc = GetRowContext(n);
-      if (rc)
-      {
-        rc->groupId = *groupId;
-      }
+      rowState_.SetGroupId(n, *groupId);
     }
     ci = &columns_[0]->columnColor[std::to_wstring(*groupId)];
     if (ci->bgColor == 0)
@@ -1147,12 +1928,11 @@ void LogContext::HandleContextMenu()
     {
       return;
     }
-    auto &&s = logTrace_->GetItemValue(selIdx, ColumnToDataItem(selectedColumn_));
-    if (s.empty())
+    ci = EditableCellColor(selectedColumn_, ViewToRow(selIdx));
+    if (!ci)
     {
       return;
     }
-    ci = &columns_[selectedColumn_]->columnColor[s];
   }
   CHOOSECOLORW color;
   ZeroMemory(&color, sizeof(color));
@@ -1184,7 +1964,7 @@ void LogContext::InvalidateView(DWORD flags)
   {
     return;
   }
-  ListView_SetItemCountEx(listView_, logTrace_->GetItemCount(), flags);
+  ListView_SetItemCountEx(listView_, ViewItemCount(), flags);
 }
 
 int LogContext::ColumnCount() const
@@ -1214,6 +1994,7 @@ void LogContext::UpdateFilterText(int controlId)
 
 void LogContext::ClearTraceUnsafe()
 {
+  ResetRows();
   logTrace_->RemoveAllItems();
   for (auto &c : columns_)
   {
@@ -1225,25 +2006,87 @@ void LogContext::ClearTraceUnsafe()
 
 void LogContext::InsertText(const std::wstring &t)
 {
-  std::map<etl::TraceEventDataItem, std::wstring> tm;
-  tm[etl::TraceEventDataItem::Message] = t;
-  InsertText(etl::GetCurrentLocalFileTime(), tm);
+  auto batch = std::make_unique<TextBatch>();
+  batch->AddRecord(etl::GetCurrentLocalFileTime());
+  batch->SetValue(etl::TraceEventDataItem::Message, t);
+  Ingest(std::move(batch));
 }
 
-void LogContext::InsertText(const FILETIME &ft, const std::map<etl::TraceEventDataItem, std::wstring> &t)
+void LogContext::Ingest(std::unique_ptr<TextBatch> batch)
 {
-  if (!logTrace_)
+  if (!batch->IsEmpty())
+  {
+    ingestQueue_.Push(std::move(batch));
+  }
+}
+
+void LogContext::StartIngest()
+{
+  if (ingestThread_)
   {
     return;
   }
-  needRedraw_ = true;
-  logTrace_->InjectItem(ft, [&t](etl::TraceEventDataItem item)
+  runIngestThread_ = true;
+  ingestThread_ = std::make_unique<std::thread>([this]()
   {
-    auto it = t.find(item);
-    return it != t.end() ? it->second : L"";
+    IngestLoop();
   });
 }
 
+void LogContext::StopIngest()
+{
+  if (!ingestThread_)
+  {
+    return;
+  }
+  // the loop empties the queue before it leaves
+  runIngestThread_ = false;
+  ingestQueue_.Wake();
+  ingestThread_->join();
+  ingestThread_.reset();
+}
+
+void LogContext::IngestLoop()
+{
+  std::unique_ptr<TextBatch> batch;
+  for (;;)
+  {
+    const bool stop = !runIngestThread_;
+    bool injected = false;
+    injecting_ = true;
+    while (ingestQueue_.Pop(&batch))
+    {
+      InjectBatch(*batch);
+      injected = true;
+    }
+    injecting_ = false;
+    if (injected)
+    {
+      RowsArrived(logTrace_->GetItemCount());
+    }
+    if (stop)
+    {
+      break;
+    }
+    if (!injected)
+    {
+      ingestQueue_.Wait(std::chrono::milliseconds(ingestWaitMs));
+    }
+  }
+}
+
+void LogContext::InjectBatch(const TextBatch &batch)
+{
+  needRedraw_ = true;
+  for (size_t r = 0; r < batch.Size(); ++r)
+  {
+    logTrace_->InjectItem(batch.Time(r), [&batch, r](etl::TraceEventDataItem item)
+    {
+      return batch.Value(r, item);
+    });
+  }
+}
+
 ///////
 
 LRESULT CALLBACK ColumnContext::SubClassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -1281,6 +2124,9 @@ LRESULT CALLBACK ColumnContext::SubClassProc(HWND hwnd, UINT msg, WPARAM wParam,
     case ID_EDIT_FINDPREVIOUS:
       self->owner_->GotoPreviousMatch();
       break;
+    case ID_VIEW_HIDENONMATCHING:
+      self->owner_->ToggleHideNonMatching();
+      break;
     }
   }
   break;
@@ -1337,6 +2183,9 @@ LRESULT CALLBACK LogContext::ListViewSubClassProc(HWND hwnd, UINT msg, WPARAM wP
     case ID_EDIT_FINDPREVIOUS:
       self->GotoPreviousMatch();
       break;
+    case ID_VIEW_HIDENONMATCHING:
+      self->ToggleHideNonMatching();
+      break;
     }
   }
   break;
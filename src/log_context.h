@@ -1,5 +1,26 @@
 #pragma once
 
+#include "row_index.h"
+#include "debouncer.h"
+#include "row_state.h"
+#include "value_stats.h"
+#include "update_coalescer.h"
+#include "text_batch.h"
+#include "serial_reader.h"
+#include "trace_format.h"
+#include "mpsc_queue.h"
+#include "log_store.h"
+#include "text_log_store.h"
+#include "snapshot.h"
+#include "text_exporter.h"
+
+#define WM_FILTERPASSDONE (WM_APP + 1)
+#define WM_FILTERPROGRESS (WM_APP + 2)
+#define WM_JOBPROGRESS (WM_APP + 3)
+#define WM_JOBDONE (WM_APP + 4)
+#define IDT_FILTERDEBOUNCE 1
+#define IDT_VIEWREFRESH 2
+
 struct ColorInfo
 {
   int count;
@@ -8,17 +29,8 @@ struct ColorInfo
   COLORREF txtColor;
 };
 
-using ColorFadeFilterList = std::list<std::pair<std::function<bool(int column, const std::wstring &value)>, float>>;
-
 class LogContext;
-
-struct RowContext
-{
-  float colorFade;
-  int lastFilterCount;
-  int groupId;
-  RowContext();
-};
+class ColumnFilter;
 
 class ColumnContext
 {
@@ -26,24 +38,39 @@ public:
   ColumnContext(HWND fWnd = nullptr, float r = 0.0f, LogContext *owner = nullptr);
   bool SetFilterText(const wchar_t *txt, int len);
   std::wstring GetFilterText() const;
+  std::shared_ptr<const ColumnFilter> GetFilter() const;
 public:
   HWND filterWindow;
   float sizeRatio;
+  // colors picked by the user and the colors of the groups in the ID column
   std::map<std::wstring, ColorInfo> columnColor;
+  // set for dictionary coded columns, their colors are kept by code. The
+  // store's own dictionary if it codes the column, else ownDictionary.
+  const ColumnDictionary *dictionary;
+  std::unique_ptr<ColumnDictionary> ownDictionary;
+  // values of a store's dictionary whose length has been looked at
+  size_t measuredValues;
+  std::vector<ColorInfo> codeColor;
+  // colors of a loaded snapshot by value, taken once the value gets a code
+  std::map<std::wstring, ColorInfo> savedCodeColor;
+  // other columns only keep bounded statistics, colors derive from the value
+  ValueStats stats;
+  std::map<std::wstring, COLORREF> frequentColor;
   size_t longestTextLength_;
   WNDPROC orgProc_;
   //
   static LRESULT CALLBACK SubClassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 private:
   LogContext *owner_;
-  std::wstring filterText_;
-  mutable std::mutex filterTextLock_;
+  // swapped atomically so that readers never block on the UI thread
+  std::shared_ptr<const ColumnFilter> filter_;
 };
 
-class LogContext
+class LogContext : private RowSource
 {
 public:
   LogContext(HINSTANCE programInstance);
+  ~LogContext();
   void ApplyFilters();
   bool AddPdbProvider(const fs::path &pdbPath);
   bool InitializeLiveSession(const std::wstring &sessionName);
@@ -55,6 +82,8 @@ public:
   bool LoadPdbFromDialog();
   bool LoadEtlFromDialog();
   bool ExportFromDialogAll();
+  bool ExportFromDialogFiltered();
+  bool ExportFromDialogTimeRange();
   bool ExportFromDialogSelected();
   bool CopySelected();
   void SetMainWindow(HWND hWnd);
@@ -63,6 +92,7 @@ public:
   void ClearTraceUnsafe();
   void ActivateColumn(NMLISTVIEW *listViewInfo);
   void SetItemText(NMLVDISPINFOW *plvdi);
+  void UpdateVisibleFades();
   void SetItemColors(NMLVCUSTOMDRAW *lvd);
   void HandleContextMenu();
   void InvalidateView(DWORD flags = 0);
@@ -71,29 +101,66 @@ public:
   void UpdateFilterText(int controlId);
   void SetComPort(const std::wstring &comPort);
   void SetBaudRate(int baudRate);
+  bool SetComFormats(const fs::path &formatsPath);
   bool StartCom();
   void StopCom();
   void GotoNextMatch();
   void GotoPreviousMatch();
   void ReloadAllPdbs();
+  void FilterPassDone(int generation);
+  void FilterProgress(int generation, int percent);
+  void JobProgress(int job);
+  void JobDone(int job, bool ok);
+  void ScheduleFilters();
+  void FilterTimer();
+  void RefreshView();
+  void ToggleHideNonMatching();
   //
 private:
-  bool ExportFromDialog(const std::function<bool(size_t *n)> &enumerator, bool includeHeader);
-  bool ExtractTextLines(const std::function<bool(size_t *n)> &enumerator, const std::function<bool(const std::wstring &txt)> &output, bool includeHeader);
+  bool ExportFromDialog(ExportRows rows, bool includeHeader);
+  bool SaveSnapshot(const ExportRows &rows, const fs::path &filePath);
+  bool StartJob(const std::wstring &name, const std::function<bool()> &job);
+  void TrackJob(TextExporter &exporter);
+  void TrackJob(SnapshotWriter &writer);
+  std::function<void(size_t doneRows, size_t totalRows)> JobProgressCallback();
+  bool CancelJob();
+  void StopJob();
+  void RestoreSnapshotState(const SnapshotStore &snapshot);
   bool FileOpenDialog(LPCWSTR filter, const std::function<bool(const fs::path &)> &fileHandler, DWORD flags = 0);
   bool FileSaveDialog(LPCWSTR filter, const std::function<bool(const fs::path &)> &fileHandler, DWORD flags = 0, const std::wstring &suggestedFileName = L"");
-  bool SetItemColorFromColumn(NMLVCUSTOMDRAW *lvd);
-  float GetFilterLineFade(size_t line);
+  bool SetItemColorFromColumn(NMLVCUSTOMDRAW *lvd, size_t row);
+  void UpdateFades(size_t first, size_t last);
   bool ResetViewNoInvalidate();
-  void InitializeRowContext(size_t line);
-  RowContext *GetRowContext(size_t line);
-  const RowContext *GetRowContext(size_t line) const;
   std::function<bool(size_t *n)> SelectedLinesEnumerator() const;
   static LRESULT CALLBACK ListViewSubClassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
   void InsertText(const std::wstring &t);
-  void InsertText(const FILETIME &ft, const std::map<etl::TraceEventDataItem, std::wstring> &t);
+  void Ingest(std::unique_ptr<TextBatch> batch);
+  void StartIngest();
+  void StopIngest();
+  void IngestLoop();
+  void InjectBatch(const TextBatch &batch);
+  void RowsArrived(size_t itemCount);
   bool FilterColumn(etl::TraceEventDataItem item, const std::wstring &txt, bool default_result = true) const;
   void GotoMatch(int dir);
+  const std::wstring &CellText(size_t row, int column) const override;
+  const ColumnDictionary *Dictionary(int column) const override;
+  void UseStoreDictionaries();
+  bool CodeRows(ColumnContext &column, etl::TraceEventDataItem item, size_t rowCount);
+  ColorInfo &CodeColor(ColumnContext &column, uint32_t code);
+  bool CellColor(int column, size_t row, ColorInfo *ci);
+  ColorInfo *EditableCellColor(int column, size_t row);
+  int ColorCount(int column) const;
+  void ResetRows();
+  void UpdateColumnRatios();
+  FilterSet CurrentFilters() const;
+  void RebuildViewIndex();
+  void RebuildMatchIndex();
+  bool FindMatch(int dir, size_t *match, size_t *row) const;
+  bool ScanForMatch(int dir, size_t *row) const;
+  void SetTitleStatus(const std::wstring &status);
+  size_t ViewItemCount() const;
+  size_t ViewToRow(size_t position) const;
+  bool RowToView(size_t row, size_t *position) const;
 private:
   HINSTANCE programInstance_;
   WNDPROC orgListViewProc_;
@@ -101,24 +168,61 @@ private:
   HWND listView_;
   DWORD itemCounter_;
   int selectedColumn_;
-  bool needRedraw_;
+  // set by the ingest thread as well
+  std::atomic<bool> needRedraw_;
   etl::FormatDatabase fmtDb_;
-  std::unique_ptr<etl::TraceEnumerator> logTrace_;
+  std::unique_ptr<LogStore> logTrace_;
   etl::PdbFileManager pdbManager_;
   std::vector<fs::path> pdbPaths_;
   std::vector<std::unique_ptr<ColumnContext>> columns_;
-  std::vector<std::unique_ptr<RowContext>> rowInfo_;
-  ColorFadeFilterList colorFilters_;
+  RowStateTable rowState_;
   COLORREF customColors_[16];
   std::wstring windowTitle_;
   std::wstring sessionName_;
   int filterId_;
-  std::mutex rowInfoLock_;
   int groupCounter_;
   std::wstring comPort_;
   int baudRate_;
+  // formats of the binary serial protocol, empty for text
+  TraceFormatTable comFormats_;
   std::unique_ptr<std::thread> comThread_;
-  bool runComThread_;
-  int currentMatchingLine_;
+  std::atomic<bool> runComThread_;
+  // row of the last find, the largest size_t while there is none
+  size_t currentMatchingLine_;
+  ThreadPool filterPool_;
+  FilterEngine filterEngine_;
+  // list view positions map to rows through viewIndex_ while this is set,
+  // read by RowsArrived, changed under rowsLock_
+  std::atomic<bool> hideNonMatching_;
+  RowIndex viewIndex_;
+  // rows with a match for find next / previous
+  RowIndex matchIndex_;
+  Debouncer filterDebounce_;
+  UpdateCoalescer viewUpdates_;
+  // the count callback leaves the rows of queued batches to IngestLoop
+  std::atomic<bool> injecting_;
+  // the loader, ingest and enumerator threads may all report rows
+  std::mutex rowsLock_;
+  // rows already seen by RowsArrived
+  size_t countedRows_;
+  // only a sample of the rows of a lazy store goes into the stats
+  bool sampleStats_;
+  // row count the UI thread works with, only grows until rows are removed
+  std::atomic<size_t> publishedRows_;
+  // capture threads queue their rows, a single thread writes them to logTrace_
+  MpscQueue<std::unique_ptr<TextBatch>> ingestQueue_;
+  std::unique_ptr<std::thread> ingestThread_;
+  std::atomic<bool> runIngestThread_;
+  // export or copy running in the background, one at a time, on the rows
+  // there were when it started
+  std::unique_ptr<std::thread> jobThread_;
+  int jobId_;
+  std::wstring jobName_;
+  std::atomic<bool> cancelJob_;
+  std::atomic<size_t> jobDoneRows_;
+  std::atomic<size_t> jobTotalRows_;
+  std::chrono::steady_clock::time_point jobStart_;
+  // text a finished copy leaves for the clipboard
+  std::wstring jobClipboard_;
 };
 
@@ -0,0 +1,143 @@
+#include "stdafx.h"
+#include "log_store.h"
+
+std::wstring FormatItemTime(const FILETIME &ft)
+{
+  SYSTEMTIME st;
+  if (!FileTimeToSystemTime(&ft, &st))
+  {
+    return L"";
+  }
+  wchar_t buffer[32];
+  swprintf(buffer, _countof(buffer), L"%04u-%02u-%02u %02u:%02u:%02u.%03u",
+           st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+  return buffer;
+}
+
+bool ParseItemTime(const wchar_t *text, size_t length, FILETIME *ft)
+{
+  // yyyy-mm-dd hh:mm:ss, the separators are only skipped
+  static const size_t digits[] = {4, 2, 2, 2, 2, 2};
+  WORD fields[_countof(digits)] = {};
+  size_t pos = 0;
+  for (size_t f = 0; f < _countof(digits); ++f)
+  {
+    if (f != 0 && pos++ >= length)
+    {
+      return false;
+    }
+    for (size_t d = 0; d < digits[f]; ++d, ++pos)
+    {
+      if (pos >= length || text[pos] < L'0' || text[pos] > L'9')
+      {
+        return false;
+      }
+      fields[f] = fields[f] * 10 + (text[pos] - L'0');
+    }
+  }
+  // fraction of the second in 100ns ticks
+  uint64_t ticks = 0;
+  size_t fractionDigits = 0;
+  if (pos < length && text[pos] == L'.')
+  {
+    for (++pos; pos < length && text[pos] >= L'0' && text[pos] <= L'9'; ++pos)
+    {
+      if (fractionDigits < 7)
+      {
+        ticks = ticks * 10 + (text[pos] - L'0');
+        ++fractionDigits;
+      }
+    }
+  }
+  for (; fractionDigits < 7; ++fractionDigits)
+  {
+    ticks *= 10;
+  }
+  SYSTEMTIME st = {};
+  st.wYear = fields[0];
+  st.wMonth = fields[1];
+  st.wDay = fields[2];
+  st.wHour = fields[3];
+  st.wMinute = fields[4];
+  st.wSecond = fields[5];
+  if (!SystemTimeToFileTime(&st, ft))
+  {
+    return false;
+  }
+  ticks += static_cast<uint64_t>(ft->dwHighDateTime) << 32 | ft->dwLowDateTime;
+  ft->dwLowDateTime = static_cast<DWORD>(ticks);
+  ft->dwHighDateTime = static_cast<DWORD>(ticks >> 32);
+  return true;
+}
+
+bool GetRowTime(const LogStore &store, size_t row, FILETIME *ft)
+{
+  if (store.GetItemTime(row, ft))
+  {
+    return true;
+  }
+  size_t length = 0;
+  auto text = store.GetItemValue(row, etl::TraceEventDataItem::TimeStamp, &length);
+  return ParseItemTime(text, length, ft);
+}
+
+EnumeratorStore::EnumeratorStore(std::unique_ptr<etl::TraceEnumerator> enumerator)
+  : enumerator_(std::move(enumerator))
+{
+}
+
+void EnumeratorStore::SetCountCallback(const std::function<void(size_t)> &callback)
+{
+  enumerator_->SetCountCallback(callback);
+}
+
+bool EnumeratorStore::Start()
+{
+  return enumerator_->Start();
+}
+
+void EnumeratorStore::Stop()
+{
+  enumerator_->Stop();
+}
+
+size_t EnumeratorStore::GetItemCount() const
+{
+  return enumerator_->GetItemCount();
+}
+
+const std::wstring &EnumeratorStore::GetItemValue(size_t row, etl::TraceEventDataItem item) const
+{
+  return enumerator_->GetItemValue(row, item);
+}
+
+const wchar_t *EnumeratorStore::GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const
+{
+  return enumerator_->GetItemValue(row, item, length);
+}
+
+bool EnumeratorStore::GetItemTime(size_t, FILETIME *) const
+{
+  // the enumerators only hand out the formatted time
+  return false;
+}
+
+const ColumnDictionary *EnumeratorStore::Dictionary(etl::TraceEventDataItem) const
+{
+  return nullptr;
+}
+
+void EnumeratorStore::ApplyFilters()
+{
+  enumerator_->ApplyFilters();
+}
+
+void EnumeratorStore::RemoveAllItems()
+{
+  enumerator_->RemoveAllItems();
+}
+
+void EnumeratorStore::InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values)
+{
+  enumerator_->InjectItem(ft, values);
+}
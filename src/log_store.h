@@ -0,0 +1,55 @@
+#pragma once
+
+class ColumnDictionary;
+
+// Rows behind the list view: an ampp enumerator for ETW sessions and .etl
+// files or a text log read by etrace itself. Capture threads inject their
+// rows into whichever store is current. The count callback may be called
+// from any thread, rows below the reported count can be read from any
+// thread.
+class LogStore
+{
+public:
+  virtual ~LogStore() = default;
+  virtual void SetCountCallback(const std::function<void(size_t)> &callback) = 0;
+  virtual bool Start() = 0;
+  virtual void Stop() = 0;
+  virtual size_t GetItemCount() const = 0;
+  virtual const std::wstring &GetItemValue(size_t row, etl::TraceEventDataItem item) const = 0;
+  virtual const wchar_t *GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const = 0;
+  // Time of the row as a number, for the stores that have it.
+  virtual bool GetItemTime(size_t row, FILETIME *ft) const = 0;
+  // Codes of an item the store dictionary codes itself, null otherwise. Rows
+  // past its CodedRows are not coded, e.g. injected ones.
+  virtual const ColumnDictionary *Dictionary(etl::TraceEventDataItem item) const = 0;
+  virtual void ApplyFilters() = 0;
+  virtual void RemoveAllItems() = 0;
+  virtual void InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values) = 0;
+};
+
+// Timestamp text for injected rows that come without one.
+std::wstring FormatItemTime(const FILETIME &ft);
+// Reads timestamp text in that layout back, a 'T' may also separate date and
+// time and the fraction may have up to seven digits.
+bool ParseItemTime(const wchar_t *text, size_t length, FILETIME *ft);
+// Time of a row from the store, else from the text of its timestamp.
+bool GetRowTime(const LogStore &store, size_t row, FILETIME *ft);
+
+class EnumeratorStore : public LogStore
+{
+public:
+  explicit EnumeratorStore(std::unique_ptr<etl::TraceEnumerator> enumerator);
+  void SetCountCallback(const std::function<void(size_t)> &callback) override;
+  bool Start() override;
+  void Stop() override;
+  size_t GetItemCount() const override;
+  const std::wstring &GetItemValue(size_t row, etl::TraceEventDataItem item) const override;
+  const wchar_t *GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const override;
+  bool GetItemTime(size_t row, FILETIME *ft) const override;
+  const ColumnDictionary *Dictionary(etl::TraceEventDataItem item) const override;
+  void ApplyFilters() override;
+  void RemoveAllItems() override;
+  void InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values) override;
+private:
+  std::unique_ptr<etl::TraceEnumerator> enumerator_;
+};
@@ -0,0 +1,153 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+  : data_(nullptr)
+  , size_(0)
+  , open_(false)
+#if defined(_WIN32)
+  , file_(INVALID_HANDLE_VALUE)
+  , mapping_(nullptr)
+#else
+  , fd_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::filesystem::path &path)
+{
+  Close();
+  file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size))
+  {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+  open_ = true;
+  if (size_ == 0)
+  {
+    // a mapping of nothing cannot be created
+    return true;
+  }
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_)
+  {
+    data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (!data_)
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (data_)
+  {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_)
+  {
+    CloseHandle(mapping_);
+  }
+  if (file_ != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(file_);
+  }
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = INVALID_HANDLE_VALUE;
+  size_ = 0;
+  open_ = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path &path)
+{
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0)
+  {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  open_ = true;
+  if (size_ == 0)
+  {
+    return true;
+  }
+  void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED)
+  {
+    Close();
+    return false;
+  }
+  madvise(p, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(p);
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (data_)
+  {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  if (fd_ >= 0)
+  {
+    close(fd_);
+  }
+  data_ = nullptr;
+  fd_ = -1;
+  size_ = 0;
+  open_ = false;
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+  return open_;
+}
+
+const char *MappedFile::Data() const
+{
+  return data_;
+}
+
+size_t MappedFile::Size() const
+{
+  return size_;
+}
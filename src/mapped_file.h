@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+
+// Read only view of a whole file. The pages come in from the file as they
+// are touched, several threads may read the view at the same time.
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  bool Open(const std::filesystem::path &path);
+  void Close();
+  bool IsOpen() const;
+  // Null for an empty file.
+  const char *Data() const;
+  size_t Size() const;
+private:
+  const char *data_;
+  size_t size_;
+  bool open_;
+#if defined(_WIN32)
+  void *file_;
+  void *mapping_;
+#else
+  int fd_;
+#endif
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Unbounded queue with any number of producers and a single consumer.
+// Pushing is one atomic exchange and never waits for the consumer, the
+// consumer takes items off in push order per producer. A consumer with
+// nothing to do may sleep in Wait, only then does a push touch the mutex to
+// wake it up.
+template <class T>
+class MpscQueue
+{
+public:
+  MpscQueue()
+    : head_(new Node)
+    , tail_(head_.load())
+    , sleeping_(false)
+  {
+  }
+
+  ~MpscQueue()
+  {
+    T value;
+    while (Pop(&value))
+    {
+    }
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Any thread.
+  void Push(T &&value)
+  {
+    auto node = new Node;
+    node->value = std::move(value);
+    auto prev = head_.exchange(node, std::memory_order_acq_rel);
+    // until this store the consumer sees the queue end at prev, it is
+    // sequentially consistent like the check in Wait so that either the
+    // consumer sees the item or the push sees the consumer sleeping
+    prev->next.store(node);
+    Wake();
+  }
+
+  // Consumer thread only.
+  bool Pop(T *value)
+  {
+    auto next = tail_->next.load(std::memory_order_acquire);
+    if (!next)
+    {
+      return false;
+    }
+    *value = std::move(next->value);
+    delete tail_;
+    // next is the new stub, its value has been taken
+    tail_ = next;
+    return true;
+  }
+
+  // Consumer thread only. Returns once an item may be there, after the
+  // timeout or after Wake.
+  void Wait(std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> l(wakeLock_);
+    sleeping_ = true;
+    if (tail_->next.load())
+    {
+      sleeping_ = false;
+      return;
+    }
+    wake_.wait_for(l, timeout, [this]() { return !sleeping_; });
+    sleeping_ = false;
+  }
+
+  // Lets a waiting consumer return, e.g. to check whether it should stop.
+  void Wake()
+  {
+    if (sleeping_.exchange(false))
+    {
+      std::lock_guard<std::mutex> l(wakeLock_);
+      wake_.notify_one();
+    }
+  }
+private:
+  struct Node
+  {
+    Node()
+      : next(nullptr)
+    {
+    }
+    std::atomic<Node *> next;
+    T value;
+  };
+  // last pushed node, producers
+  std::atomic<Node *> head_;
+  // stub before the oldest item, consumer
+  Node *tail_;
+  std::atomic<bool> sleeping_;
+  std::mutex wakeLock_;
+  std::condition_variable wake_;
+};
@@ -0,0 +1,117 @@
+#include "regex_matcher.h"
+#include "regex_syntax.h"
+#include "lazy_dfa.h"
+#include "literal_scan.h"
+
+#include <regex>
+
+namespace
+{
+
+class DfaMatcher : public RegexMatcher
+{
+public:
+  explicit DfaMatcher(std::unique_ptr<LazyDfa> &&dfa)
+    : dfa_(std::move(dfa))
+  {
+  }
+
+  bool Search(const wchar_t *begin, const wchar_t *end) const override
+  {
+    return dfa_->Search(begin, end);
+  }
+
+  bool IsLinear() const override
+  {
+    return true;
+  }
+
+private:
+  std::unique_ptr<LazyDfa> dfa_;
+};
+
+// Runs the vectorized literal scan first and only hands cells that contain
+// the literal every match requires to the full matcher. Without a full
+// matcher the pattern is the literal itself.
+class PrefilteredMatcher : public RegexMatcher
+{
+public:
+  PrefilteredMatcher(const std::wstring &literal, std::unique_ptr<RegexMatcher> &&matcher)
+    : scanner_(literal)
+    , matcher_(std::move(matcher))
+  {
+  }
+
+  bool Search(const wchar_t *begin, const wchar_t *end) const override
+  {
+    if (!scanner_.Find(begin, end))
+    {
+      return false;
+    }
+    return !matcher_ || matcher_->Search(begin, end);
+  }
+
+  bool IsLinear() const override
+  {
+    return !matcher_ || matcher_->IsLinear();
+  }
+
+private:
+  LiteralScanner scanner_;
+  std::unique_ptr<RegexMatcher> matcher_;
+};
+
+class StdRegexMatcher : public RegexMatcher
+{
+public:
+  explicit StdRegexMatcher(const std::wstring &pattern)
+    : regex_(pattern, std::regex_constants::icase)
+  {
+  }
+
+  bool Search(const wchar_t *begin, const wchar_t *end) const override
+  {
+    return std::regex_search(begin, end, regex_);
+  }
+
+  bool IsLinear() const override
+  {
+    return false;
+  }
+
+private:
+  std::wregex regex_;
+};
+
+} // private namespace
+
+std::unique_ptr<RegexMatcher> CompileRegexMatcher(const std::wstring &pattern)
+{
+  auto root = ParseRegex(pattern);
+  if (!root)
+  {
+    return std::make_unique<StdRegexMatcher>(pattern);
+  }
+  std::wstring literal;
+  if (ExactLiteral(*root, &literal) && !literal.empty())
+  {
+    return std::make_unique<PrefilteredMatcher>(literal, nullptr);
+  }
+  std::unique_ptr<RegexMatcher> matcher;
+  auto dfa = LazyDfa::Compile(*root);
+  if (dfa)
+  {
+    matcher = std::make_unique<DfaMatcher>(std::move(dfa));
+  }
+  else
+  {
+    matcher = std::make_unique<StdRegexMatcher>(pattern);
+  }
+  literal = RequiredLiteral(*root);
+  // a single character is found just as quickly by the matcher itself
+  if (literal.length() < 2)
+  {
+    return matcher;
+  }
+  return std::make_unique<PrefilteredMatcher>(literal, std::move(matcher));
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// Case insensitive "does the pattern occur anywhere in the text" test used
+// by the column filters.
+class RegexMatcher
+{
+public:
+  virtual ~RegexMatcher() = default;
+  virtual bool Search(const wchar_t *begin, const wchar_t *end) const = 0;
+  // true when the linear time automaton is used rather than std::regex
+  virtual bool IsLinear() const = 0;
+};
+
+// Picks the automaton based matcher when the pattern stays within the
+// supported subset and std::wregex otherwise, in both cases behind a literal
+// prefilter when the pattern requires one. Throws std::regex_error for
+// patterns std::regex refuses as well.
+std::unique_ptr<RegexMatcher> CompileRegexMatcher(const std::wstring &pattern);
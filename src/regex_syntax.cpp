@@ -0,0 +1,592 @@
+#include "regex_syntax.h"
+
+#include <algorithm>
+#include <climits>
+#include <cwchar>
+
+namespace
+{
+
+// Expanding x{n,m} copies the sub expression, keep patterns that would
+// explode in size with the std::regex fallback.
+const int MaxRepeatCount = 256;
+// Ranges larger than this are not folded character by character.
+const uint32_t MaxFoldedRangeSize = 0x1000;
+
+struct Unsupported
+{
+};
+
+void Normalize(CharSet &set)
+{
+  std::sort(set.begin(), set.end(), [](const CharRange &a, const CharRange &b) { return a.lo < b.lo; });
+  CharSet merged;
+  for (auto &&r : set)
+  {
+    if (!merged.empty() && r.lo <= merged.back().hi + 1)
+    {
+      merged.back().hi = std::max(merged.back().hi, r.hi);
+    }
+    else
+    {
+      merged.push_back(r);
+    }
+  }
+  set.swap(merged);
+}
+
+CharSet Complement(const CharSet &set)
+{
+  CharSet rv;
+  uint32_t next = 0;
+  for (auto &&r : set)
+  {
+    if (r.lo > next)
+    {
+      rv.push_back({next, r.lo - 1});
+    }
+    next = r.hi + 1;
+  }
+  if (next <= MaxCodeUnit())
+  {
+    rv.push_back({next, MaxCodeUnit()});
+  }
+  return rv;
+}
+
+CharSet Fold(const CharSet &set)
+{
+  CharSet rv;
+  for (auto &&r : set)
+  {
+    if (r.hi - r.lo < MaxFoldedRangeSize)
+    {
+      for (uint32_t ch = r.lo; ch <= r.hi; ++ch)
+      {
+        const auto f = FoldCase(ch);
+        rv.push_back({f, f});
+      }
+    }
+    else
+    {
+      // huge ranges (negated classes, \W...) already cover most of their
+      // folded counterparts, only make sure ASCII behaves exactly
+      rv.push_back(r);
+      for (uint32_t ch = r.lo; ch <= r.hi && ch < 0x80; ++ch)
+      {
+        const auto f = FoldCase(ch);
+        rv.push_back({f, f});
+      }
+    }
+  }
+  Normalize(rv);
+  return rv;
+}
+
+CharSet SingleChar(wchar_t ch)
+{
+  const auto c = static_cast<uint32_t>(ch);
+  return CharSet{{c, c}};
+}
+
+CharSet DigitSet()
+{
+  return CharSet{{L'0', L'9'}};
+}
+
+CharSet WordSet()
+{
+  return CharSet{{L'0', L'9'}, {L'A', L'Z'}, {L'_', L'_'}, {L'a', L'z'}};
+}
+
+CharSet SpaceSet()
+{
+  return CharSet{{L'\t', L'\r'}, {L' ', L' '}};
+}
+
+std::unique_ptr<RegexNode> MakeNode(RegexOp op)
+{
+  auto node = std::make_unique<RegexNode>();
+  node->op = op;
+  return node;
+}
+
+class Parser
+{
+public:
+  explicit Parser(const std::wstring &pattern)
+    : pattern_(pattern)
+    , pos_(0)
+  {
+  }
+
+  std::unique_ptr<RegexNode> Parse()
+  {
+    auto node = ParseAlternation();
+    if (!AtEnd())
+    {
+      // unbalanced ')'
+      throw Unsupported();
+    }
+    return node;
+  }
+
+private:
+  bool AtEnd() const
+  {
+    return pos_ >= pattern_.length();
+  }
+
+  wchar_t Peek() const
+  {
+    return AtEnd() ? 0 : pattern_[pos_];
+  }
+
+  wchar_t Next()
+  {
+    if (AtEnd())
+    {
+      throw Unsupported();
+    }
+    return pattern_[pos_++];
+  }
+
+  std::unique_ptr<RegexNode> ParseAlternation()
+  {
+    auto first = ParseConcatenation();
+    if (Peek() != L'|')
+    {
+      return first;
+    }
+    auto node = MakeNode(RegexOp::Alternate);
+    node->children.push_back(std::move(first));
+    while (Peek() == L'|')
+    {
+      ++pos_;
+      node->children.push_back(ParseConcatenation());
+    }
+    return node;
+  }
+
+  std::unique_ptr<RegexNode> ParseConcatenation()
+  {
+    auto node = MakeNode(RegexOp::Concat);
+    while (!AtEnd() && Peek() != L'|' && Peek() != L')')
+    {
+      node->children.push_back(ParseRepeat());
+    }
+    if (node->children.empty())
+    {
+      return MakeNode(RegexOp::Empty);
+    }
+    if (node->children.size() == 1)
+    {
+      return std::move(node->children.front());
+    }
+    return node;
+  }
+
+  std::unique_ptr<RegexNode> ParseRepeat()
+  {
+    auto atom = ParseAtom();
+    for (;;)
+    {
+      int min = 0;
+      int max = 0;
+      const auto ch = Peek();
+      if (ch == L'*')
+      {
+        ++pos_;
+        max = RegexNode::Unbounded;
+      }
+      else if (ch == L'+')
+      {
+        ++pos_;
+        min = 1;
+        max = RegexNode::Unbounded;
+      }
+      else if (ch == L'?')
+      {
+        ++pos_;
+        max = 1;
+      }
+      else if (ch == L'{')
+      {
+        ++pos_;
+        min = ParseNumber();
+        max = min;
+        if (Peek() == L',')
+        {
+          ++pos_;
+          max = Peek() == L'}' ? RegexNode::Unbounded : ParseNumber();
+        }
+        if (Next() != L'}' || (max != RegexNode::Unbounded && max < min))
+        {
+          throw Unsupported();
+        }
+      }
+      else
+      {
+        return atom;
+      }
+      if (atom->op == RegexOp::BeginText || atom->op == RegexOp::EndText)
+      {
+        throw Unsupported();
+      }
+      // non greedy quantifiers match the same set of strings
+      if (Peek() == L'?')
+      {
+        ++pos_;
+      }
+      auto node = MakeNode(RegexOp::Repeat);
+      node->min = min;
+      node->max = max;
+      node->children.push_back(std::move(atom));
+      atom = std::move(node);
+    }
+  }
+
+  int ParseNumber()
+  {
+    int n = 0;
+    int digits = 0;
+    while (Peek() >= L'0' && Peek() <= L'9')
+    {
+      n = n * 10 + (Next() - L'0');
+      if (n > MaxRepeatCount)
+      {
+        throw Unsupported();
+      }
+      ++digits;
+    }
+    if (digits == 0)
+    {
+      throw Unsupported();
+    }
+    return n;
+  }
+
+  std::unique_ptr<RegexNode> ParseAtom()
+  {
+    const auto ch = Next();
+    switch (ch)
+    {
+    case L'(':
+    {
+      if (Peek() == L'?')
+      {
+        ++pos_;
+        if (Next() != L':')
+        {
+          // look-ahead assertions
+          throw Unsupported();
+        }
+      }
+      auto node = ParseAlternation();
+      if (Next() != L')')
+      {
+        throw Unsupported();
+      }
+      return node;
+    }
+    case L'[':
+    {
+      auto node = MakeNode(RegexOp::Chars);
+      node->chars = ParseClass();
+      return node;
+    }
+    case L'.':
+      // everything but the ECMAScript line terminators
+      return CharsNode(Complement(CharSet{{L'\n', L'\n'}, {L'\r', L'\r'}, {0x2028, 0x2029}}));
+    case L'^':
+      return MakeNode(RegexOp::BeginText);
+    case L'$':
+      return MakeNode(RegexOp::EndText);
+    case L'\\':
+      return CharsNode(ParseEscape(false));
+    case L'*':
+    case L'+':
+    case L'?':
+    case L'{':
+    case L'}':
+    case L']':
+    case L')':
+    case L'|':
+      throw Unsupported();
+    default:
+      return CharsNode(SingleChar(ch));
+    }
+  }
+
+  std::unique_ptr<RegexNode> CharsNode(const CharSet &set)
+  {
+    auto node = MakeNode(RegexOp::Chars);
+    node->chars = Fold(set);
+    return node;
+  }
+
+  uint32_t ParseHex(int digits)
+  {
+    uint32_t v = 0;
+    for (int i = 0; i < digits; ++i)
+    {
+      const auto ch = Next();
+      v <<= 4;
+      if (ch >= L'0' && ch <= L'9')
+      {
+        v |= ch - L'0';
+      }
+      else if (ch >= L'a' && ch <= L'f')
+      {
+        v |= ch - L'a' + 10;
+      }
+      else if (ch >= L'A' && ch <= L'F')
+      {
+        v |= ch - L'A' + 10;
+      }
+      else
+      {
+        throw Unsupported();
+      }
+    }
+    return v;
+  }
+
+  CharSet ParseEscape(bool inClass)
+  {
+    const auto ch = Next();
+    uint32_t single = ch;
+    switch (ch)
+    {
+    case L'd':
+      return DigitSet();
+    case L'D':
+      return Complement(DigitSet());
+    case L'w':
+      return WordSet();
+    case L'W':
+      return Complement(WordSet());
+    case L's':
+      return SpaceSet();
+    case L'S':
+      return Complement(SpaceSet());
+    case L't':
+      single = L'\t';
+      break;
+    case L'n':
+      single = L'\n';
+      break;
+    case L'r':
+      single = L'\r';
+      break;
+    case L'f':
+      single = L'\f';
+      break;
+    case L'v':
+      single = L'\v';
+      break;
+    case L'x':
+      single = ParseHex(2);
+      break;
+    case L'u':
+      single = ParseHex(4);
+      break;
+    case L'b':
+      if (!inClass)
+      {
+        // word boundary
+        throw Unsupported();
+      }
+      single = L'\b';
+      break;
+    default:
+      // back references, \B, \c, \0...
+      if ((ch >= L'0' && ch <= L'9') || (ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z'))
+      {
+        throw Unsupported();
+      }
+      break;
+    }
+    if (single > MaxCodeUnit())
+    {
+      throw Unsupported();
+    }
+    return CharSet{{single, single}};
+  }
+
+  CharSet ParseClass()
+  {
+    bool negate = false;
+    if (Peek() == L'^')
+    {
+      ++pos_;
+      negate = true;
+    }
+    if (Peek() == L']')
+    {
+      // empty classes are legal in ECMAScript but never what people mean
+      throw Unsupported();
+    }
+    CharSet set;
+    while (Peek() != L']')
+    {
+      if (Peek() == L'[')
+      {
+        // [:alpha:], [.x.] and [=x=]
+        throw Unsupported();
+      }
+      CharSet item = Next() == L'\\' ? ParseEscape(true) : SingleChar(pattern_[pos_ - 1]);
+      if (Peek() == L'-' && pos_ + 1 < pattern_.length() && pattern_[pos_ + 1] != L']')
+      {
+        ++pos_;
+        CharSet upper = Next() == L'\\' ? ParseEscape(true) : SingleChar(pattern_[pos_ - 1]);
+        if (item.size() != 1 || upper.size() != 1 || item[0].lo != item[0].hi || upper[0].lo != upper[0].hi || upper[0].lo < item[0].lo)
+        {
+          throw Unsupported();
+        }
+        item[0].hi = upper[0].lo;
+      }
+      set.insert(set.end(), item.begin(), item.end());
+    }
+    ++pos_;
+    Normalize(set);
+    if (negate)
+    {
+      // negation has to happen on the folded set, otherwise [^a] would
+      // still accept 'A'
+      return Complement(Fold(set));
+    }
+    return Fold(set);
+  }
+
+private:
+  const std::wstring &pattern_;
+  size_t pos_;
+};
+
+bool IsSingleChar(const RegexNode &node)
+{
+  return node.op == RegexOp::Chars && node.chars.size() == 1 && node.chars[0].lo == node.chars[0].hi;
+}
+
+void Flush(std::wstring &run, std::wstring &best)
+{
+  if (run.length() > best.length())
+  {
+    best = run;
+  }
+  run.clear();
+}
+
+void CollectLiterals(const RegexNode &node, std::wstring &run, std::wstring &best)
+{
+  std::wstring literal;
+  switch (node.op)
+  {
+  case RegexOp::Empty:
+  case RegexOp::BeginText:
+  case RegexOp::EndText:
+    // zero width, adjacent literals stay adjacent
+    break;
+  case RegexOp::Chars:
+    if (IsSingleChar(node))
+    {
+      run += static_cast<wchar_t>(node.chars[0].lo);
+    }
+    else
+    {
+      Flush(run, best);
+    }
+    break;
+  case RegexOp::Concat:
+    for (auto &&c : node.children)
+    {
+      CollectLiterals(*c, run, best);
+    }
+    break;
+  case RegexOp::Repeat:
+    if (node.min == 0)
+    {
+      Flush(run, best);
+    }
+    else if (ExactLiteral(*node.children.front(), &literal))
+    {
+      // the first repetition extends what came before, the last one is
+      // followed by what comes after
+      for (int i = 0; i < node.min; ++i)
+      {
+        run += literal;
+      }
+      if (node.max != node.min)
+      {
+        Flush(run, best);
+        run = literal;
+      }
+    }
+    else
+    {
+      Flush(run, best);
+      literal = RequiredLiteral(*node.children.front());
+      Flush(literal, best);
+    }
+    break;
+  case RegexOp::Alternate:
+    Flush(run, best);
+    break;
+  }
+}
+
+} // private namespace
+
+uint32_t MaxCodeUnit()
+{
+  return WCHAR_MAX > 0x10FFFF ? 0x10FFFF : static_cast<uint32_t>(WCHAR_MAX);
+}
+
+std::unique_ptr<RegexNode> ParseRegex(const std::wstring &pattern)
+{
+  try
+  {
+    return Parser(pattern).Parse();
+  }
+  catch (const Unsupported &)
+  {
+    return nullptr;
+  }
+}
+
+bool ExactLiteral(const RegexNode &node, std::wstring *literal)
+{
+  switch (node.op)
+  {
+  case RegexOp::Empty:
+    return true;
+  case RegexOp::Chars:
+    if (!IsSingleChar(node))
+    {
+      return false;
+    }
+    *literal += static_cast<wchar_t>(node.chars[0].lo);
+    return true;
+  case RegexOp::Concat:
+    for (auto &&c : node.children)
+    {
+      if (!ExactLiteral(*c, literal))
+      {
+        return false;
+      }
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::wstring RequiredLiteral(const RegexNode &root)
+{
+  std::wstring run;
+  std::wstring best;
+  CollectLiterals(root, run, best);
+  Flush(run, best);
+  return best;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cwctype>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Inclusive range of (case folded) code units.
+struct CharRange
+{
+  uint32_t lo;
+  uint32_t hi;
+};
+
+using CharSet = std::vector<CharRange>;
+
+enum class RegexOp
+{
+  Empty,
+  Chars,
+  Concat,
+  Alternate,
+  Repeat,
+  BeginText,
+  EndText,
+};
+
+// Parsed form of the subset of ECMAScript syntax that the automaton based
+// matchers understand. All character sets are already case folded.
+struct RegexNode
+{
+  static const int Unbounded = -1;
+
+  RegexOp op = RegexOp::Empty;
+  CharSet chars;
+  int min = 0;
+  int max = 0;
+  std::vector<std::unique_ptr<RegexNode>> children;
+};
+
+// Largest code unit a wchar_t can hold on this platform.
+uint32_t MaxCodeUnit();
+
+// Simple case folding used both for patterns and for subject text.
+inline uint32_t FoldCase(uint32_t ch)
+{
+  if (ch < 0x80)
+  {
+    return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
+  }
+  return static_cast<uint32_t>(towlower(static_cast<wint_t>(ch)));
+}
+
+// Returns nullptr when the pattern uses a construct outside of the supported
+// subset (back references, assertions other than ^ and $, named classes...)
+// or is not well formed, callers are then expected to fall back to std::regex.
+std::unique_ptr<RegexNode> ParseRegex(const std::wstring &pattern);
+
+// True if the node matches exactly one (folded) string, which is then
+// returned in literal.
+bool ExactLiteral(const RegexNode &node, std::wstring *literal);
+
+// Longest folded string that has to occur in any text the pattern matches,
+// may be empty.
+std::wstring RequiredLiteral(const RegexNode &root);
@@ -27,6 +27,9 @@
 #define ID_EDIT_FINDNEXT                32780
 #define ID_EDIT_FINDPREVIOUS            32781
 #define ID_EDIT_CLEAR                   32785
+#define ID_VIEW_HIDENONMATCHING         32788
+#define ID_FILE_EXPORTFILTERED          32789
+#define ID_FILE_EXPORTTIMERANGE         32790
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -35,7 +38,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        130
-#define _APS_NEXT_COMMAND_VALUE         32788
+#define _APS_NEXT_COMMAND_VALUE         32791
 #define _APS_NEXT_CONTROL_VALUE         1005
 #define _APS_NEXT_SYMED_VALUE           110
 #endif
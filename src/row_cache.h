@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Rows one thread decoded from a store that keeps its values encoded, least
+// recently read go first. Stores keep one cache per thread, so a value they
+// hand out stays valid until the thread has read Rows other rows and readers
+// never lock. The owner tells the rows of different stores apart.
+template <size_t CellCount>
+class RowCache
+{
+public:
+  static const size_t Rows = 0x400;
+  struct Entry
+  {
+    uint64_t owner;
+    size_t row;
+    // bit per cell that is decoded
+    uint32_t decoded;
+    std::wstring cells[CellCount];
+  };
+
+  static uint64_t NewOwner()
+  {
+    static std::atomic<uint64_t> next(1);
+    return next++;
+  }
+
+  Entry &Get(uint64_t owner, size_t row)
+  {
+    auto it = index_.find(row);
+    if (it != index_.end())
+    {
+      entries_.splice(entries_.begin(), entries_, it->second);
+    }
+    else
+    {
+      if (entries_.size() < Rows)
+      {
+        entries_.emplace_front();
+      }
+      else
+      {
+        // the strings keep their capacity for the next row
+        entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+        index_.erase(entries_.front().row);
+      }
+      entries_.front().row = row;
+      entries_.front().owner = 0;
+      index_[row] = entries_.begin();
+    }
+    auto &entry = entries_.front();
+    if (entry.owner != owner)
+    {
+      entry.owner = owner;
+      entry.decoded = 0;
+      for (auto &c : entry.cells)
+      {
+        c.clear();
+      }
+    }
+    return entry;
+  }
+private:
+  // most recently read first
+  std::list<Entry> entries_;
+  std::unordered_map<size_t, typename std::list<Entry>::iterator> index_;
+};
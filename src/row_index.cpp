@@ -0,0 +1,126 @@
+#include "row_index.h"
+
+#include <algorithm>
+
+RowIndex::RowIndex(RowTest test)
+  : test_(test)
+  , generation_(-1)
+  , all_(true)
+  , coveredRows_(0)
+{
+}
+
+void RowIndex::Clear()
+{
+  std::lock_guard<std::mutex> l(lock_);
+  generation_ = -1;
+  filters_.clear();
+  evaluator_.reset();
+  all_ = true;
+  rows_.clear();
+  coveredRows_ = 0;
+}
+
+void RowIndex::AssignAll(int generation, size_t coveredRows)
+{
+  std::lock_guard<std::mutex> l(lock_);
+  generation_ = generation;
+  filters_.clear();
+  evaluator_.reset();
+  all_ = true;
+  rows_.clear();
+  rows_.shrink_to_fit();
+  coveredRows_ = coveredRows;
+}
+
+void RowIndex::Assign(int generation, const FilterSet &filters, std::vector<size_t> &&rows, size_t coveredRows)
+{
+  std::lock_guard<std::mutex> l(lock_);
+  generation_ = generation;
+  filters_ = filters;
+  evaluator_.reset();
+  all_ = false;
+  rows_ = std::move(rows);
+  coveredRows_ = coveredRows;
+}
+
+void RowIndex::Extend(const RowSource &source, size_t rowCount)
+{
+  std::vector<size_t> selected;
+  for (;;)
+  {
+    std::shared_ptr<const FilterEvaluator> evaluator;
+    size_t first = 0;
+    {
+      std::lock_guard<std::mutex> l(lock_);
+      if (generation_ < 0 || coveredRows_ >= rowCount)
+      {
+        return;
+      }
+      if (all_)
+      {
+        coveredRows_ = rowCount;
+        return;
+      }
+      if (!evaluator_)
+      {
+        evaluator_ = std::make_shared<FilterEvaluator>(source, filters_);
+      }
+      evaluator = evaluator_;
+      first = coveredRows_;
+    }
+    selected.clear();
+    for (size_t row = first; row < rowCount; ++row)
+    {
+      if (((*evaluator).*test_)(row))
+      {
+        selected.push_back(row);
+      }
+    }
+    std::lock_guard<std::mutex> l(lock_);
+    // assigned or extended meanwhile, the rows are tested again against
+    // what the index holds now
+    if (evaluator_ != evaluator || coveredRows_ != first)
+    {
+      continue;
+    }
+    rows_.insert(rows_.end(), selected.begin(), selected.end());
+    coveredRows_ = rowCount;
+    return;
+  }
+}
+
+int RowIndex::Generation() const
+{
+  std::lock_guard<std::mutex> l(lock_);
+  return generation_;
+}
+
+size_t RowIndex::Count() const
+{
+  std::lock_guard<std::mutex> l(lock_);
+  return all_ ? coveredRows_ : rows_.size();
+}
+
+size_t RowIndex::RowAt(size_t position) const
+{
+  std::lock_guard<std::mutex> l(lock_);
+  if (all_ || position >= rows_.size())
+  {
+    return position;
+  }
+  return rows_[position];
+}
+
+bool RowIndex::PositionOf(size_t row, size_t *position) const
+{
+  std::lock_guard<std::mutex> l(lock_);
+  if (all_)
+  {
+    *position = row;
+    return row < coveredRows_;
+  }
+  auto it = std::lower_bound(rows_.begin(), rows_.end(), row);
+  *position = it - rows_.begin();
+  return it != rows_.end() && *it == row;
+}
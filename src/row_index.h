@@ -0,0 +1,39 @@
+#pragma once
+
+#include "filter_engine.h"
+
+// Sorted list of the rows selected by a row test, e.g. the rows passing the
+// column filters to map list view positions while the others are hidden, or
+// the rows with a match for find next. The list is built from a finished
+// filter pass and then extended with every row that arrives afterwards,
+// tested against the filters the list was built with.
+class RowIndex
+{
+public:
+  using RowTest = bool (FilterEvaluator::*)(size_t row) const;
+  explicit RowIndex(RowTest test);
+  void Clear();
+  // Selects every row in [0, coveredRows) and all rows added later.
+  void AssignAll(int generation, size_t coveredRows);
+  // Rows must be sorted and cover everything below coveredRows.
+  void Assign(int generation, const FilterSet &filters, std::vector<size_t> &&rows, size_t coveredRows);
+  // Tests rows [covered, rowCount) and appends those selected. The rows are
+  // tested without holding the lock, readers only wait for the append.
+  void Extend(const RowSource &source, size_t rowCount);
+  int Generation() const;
+  size_t Count() const;
+  size_t RowAt(size_t position) const;
+  // Returns false if the row is not selected, position is then where it would be.
+  bool PositionOf(size_t row, size_t *position) const;
+private:
+  RowTest test_;
+  mutable std::mutex lock_;
+  int generation_;
+  FilterSet filters_;
+  // bound to the source on the first Extend, kept alive by an Extend still
+  // testing rows while the index is assigned anew
+  std::shared_ptr<const FilterEvaluator> evaluator_;
+  bool all_;
+  std::vector<size_t> rows_;
+  size_t coveredRows_;
+};
@@ -0,0 +1,104 @@
+#include "row_state.h"
+
+struct RowStateTable::Chunk
+{
+  float colorFade[ChunkRows];
+  int lastFilterCount[ChunkRows];
+  int groupId[ChunkRows];
+  Chunk()
+  {
+    for (size_t i = 0; i < ChunkRows; ++i)
+    {
+      colorFade[i] = 1.0f;
+      lastFilterCount[i] = -1;
+      groupId[i] = 0;
+    }
+  }
+};
+
+RowStateTable::RowStateTable()
+  : chunks_(new std::atomic<Chunk *>[MaxChunks])
+{
+  for (size_t i = 0; i < MaxChunks; ++i)
+  {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+RowStateTable::~RowStateTable()
+{
+  Clear();
+}
+
+void RowStateTable::Clear()
+{
+  for (size_t i = 0; i < MaxChunks; ++i)
+  {
+    delete chunks_[i].exchange(nullptr);
+  }
+}
+
+const RowStateTable::Chunk *RowStateTable::Find(size_t row) const
+{
+  const size_t chunk = row / ChunkRows;
+  return chunk < MaxChunks ? chunks_[chunk].load(std::memory_order_acquire) : nullptr;
+}
+
+RowStateTable::Chunk *RowStateTable::Get(size_t row)
+{
+  const size_t chunk = row / ChunkRows;
+  if (chunk >= MaxChunks)
+  {
+    return nullptr;
+  }
+  auto c = chunks_[chunk].load(std::memory_order_acquire);
+  if (!c)
+  {
+    // two threads may race for a new chunk, the loser frees its copy
+    auto fresh = new Chunk();
+    if (chunks_[chunk].compare_exchange_strong(c, fresh, std::memory_order_acq_rel))
+    {
+      c = fresh;
+    }
+    else
+    {
+      delete fresh;
+    }
+  }
+  return c;
+}
+
+float RowStateTable::ColorFade(size_t row) const
+{
+  auto c = Find(row);
+  return c ? c->colorFade[row % ChunkRows] : 1.0f;
+}
+
+int RowStateTable::LastFilterCount(size_t row) const
+{
+  auto c = Find(row);
+  return c ? c->lastFilterCount[row % ChunkRows] : -1;
+}
+
+int RowStateTable::GroupId(size_t row) const
+{
+  auto c = Find(row);
+  return c ? c->groupId[row % ChunkRows] : 0;
+}
+
+void RowStateTable::SetFade(size_t row, float colorFade, int filterCount)
+{
+  if (auto c = Get(row))
+  {
+    c->colorFade[row % ChunkRows] = colorFade;
+    c->lastFilterCount[row % ChunkRows] = filterCount;
+  }
+}
+
+void RowStateTable::SetGroupId(size_t row, int groupId)
+{
+  if (auto c = Get(row))
+  {
+    c->groupId[row % ChunkRows] = groupId;
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Per row view state stored column wise in large fixed size chunks instead
+// of one heap object per row. A chunk is allocated the first time one of its
+// rows is written and never moves afterwards, reading a row that was never
+// written returns the defaults. Nothing is locked, a row is expected to be
+// written by one thread at a time.
+class RowStateTable
+{
+public:
+  RowStateTable();
+  ~RowStateTable();
+  RowStateTable(const RowStateTable &) = delete;
+  RowStateTable &operator=(const RowStateTable &) = delete;
+  // Drops every chunk, no other thread may access the table meanwhile.
+  void Clear();
+  float ColorFade(size_t row) const;
+  int LastFilterCount(size_t row) const;
+  int GroupId(size_t row) const;
+  void SetFade(size_t row, float colorFade, int filterCount);
+  void SetGroupId(size_t row, int groupId);
+private:
+  struct Chunk;
+  const Chunk *Find(size_t row) const;
+  Chunk *Get(size_t row);
+private:
+  static const size_t ChunkRows = 0x10000;
+  static const size_t MaxChunks = 0x4000;
+  // directory of MaxChunks entries, kept off the stack of the owner
+  std::unique_ptr<std::atomic<Chunk *>[]> chunks_;
+};
@@ -0,0 +1,90 @@
+#include "serial_reader.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+const int reconnectDelayMs = 500;
+const int readWaitMs = 500;
+
+} // private namespace
+
+SerialReader::SerialReader(std::unique_ptr<SerialTransport> transport, const std::wstring &port, int baudRate, char delimiter)
+  : transport_(std::move(transport))
+  , port_(port)
+  , baudRate_(baudRate)
+  , framer_(0x800, 0x10000, delimiter)
+{
+}
+
+void SerialReader::Run(const std::atomic<bool> &running, const LinesHandler &onLines, const ErrorHandler &onError)
+{
+  enum class ComState {Connecting, RequestData, WaitForData, ConsumeData};
+  ComState state = ComState::Connecting;
+  size_t bytesRead = 0;
+  const auto addLine = [this](const char *line, size_t length)
+  {
+    lines_.push_back({line, length});
+  };
+  while (running)
+  {
+    if (state == ComState::Connecting)
+    {
+      if (transport_->Open(port_, baudRate_))
+      {
+        // a partial line from before the connection dropped would be glued
+        // to the first line read now
+        framer_.Clear();
+        state = ComState::RequestData;
+      }
+      else
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(reconnectDelayMs));
+      }
+    }
+    if (state == ComState::RequestData)
+    {
+      switch (transport_->StartRead(framer_.ReadBuffer(), framer_.ReadSize(), &bytesRead))
+      {
+      case SerialTransport::ReadResult::Data:
+        state = ComState::ConsumeData;
+        break;
+      case SerialTransport::ReadResult::Pending:
+        state = ComState::WaitForData;
+        break;
+      case SerialTransport::ReadResult::Error:
+        onError(transport_->LastError());
+        state = ComState::Connecting;
+        break;
+      }
+    }
+    if (state == ComState::WaitForData)
+    {
+      switch (transport_->WaitRead(readWaitMs, &bytesRead))
+      {
+      case SerialTransport::ReadResult::Data:
+        state = ComState::ConsumeData;
+        break;
+      case SerialTransport::ReadResult::Pending:
+        break;
+      case SerialTransport::ReadResult::Error:
+        onError(transport_->LastError());
+        state = ComState::Connecting;
+        break;
+      }
+    }
+    if (state == ComState::ConsumeData)
+    {
+      lines_.clear();
+      framer_.Consume(bytesRead, addLine);
+      if (!lines_.empty())
+      {
+        onLines(lines_);
+      }
+      state = ComState::RequestData;
+    }
+  }
+  transport_->Close();
+}
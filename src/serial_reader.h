@@ -0,0 +1,32 @@
+#pragma once
+
+#include "line_framer.h"
+#include "serial_transport.h"
+
+#include <atomic>
+
+// Connect / read / frame loop of the serial capture, independent of the
+// platform through SerialTransport. Errors are reported and followed by a
+// reconnect, lines are handed out once per read.
+class SerialReader
+{
+public:
+  struct Line
+  {
+    const char *text;
+    size_t length;
+  };
+  // The lines point into the reader's buffer and are valid during the call.
+  using LinesHandler = std::function<void(const std::vector<Line> &lines)>;
+  using ErrorHandler = std::function<void(const std::wstring &message)>;
+  // Lines end at delimiter, '\0' for COBS framed binary records.
+  SerialReader(std::unique_ptr<SerialTransport> transport, const std::wstring &port, int baudRate, char delimiter = '\n');
+  // Runs until running is cleared, checked at least every half second.
+  void Run(const std::atomic<bool> &running, const LinesHandler &onLines, const ErrorHandler &onError);
+private:
+  std::unique_ptr<SerialTransport> transport_;
+  std::wstring port_;
+  int baudRate_;
+  LineFramer framer_;
+  std::vector<Line> lines_;
+};
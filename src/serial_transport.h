@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// Byte source behind the serial reader. A read is started into a buffer and,
+// if no data is there yet, waited for in slices so the reader can stop in
+// between. The buffer has to stay valid until the read completes or the
+// transport is closed.
+class SerialTransport
+{
+public:
+  enum class ReadResult
+  {
+    Data,
+    Pending,
+    Error
+  };
+  virtual ~SerialTransport() = default;
+  // Port is e.g. \\.\COM3 on Windows or /dev/ttyUSB0 elsewhere, any baud
+  // rate the driver accepts can be used.
+  virtual bool Open(const std::wstring &port, int baudRate) = 0;
+  virtual void Close() = 0;
+  virtual ReadResult StartRead(char *buffer, size_t size, size_t *bytesRead) = 0;
+  // Waits up to timeoutMs for the started read, Pending if it is still open.
+  virtual ReadResult WaitRead(int timeoutMs, size_t *bytesRead) = 0;
+  // Describes the last Error result.
+  virtual const std::wstring &LastError() const = 0;
+};
+
+// Overlapped I/O on Windows, termios and epoll elsewhere.
+std::unique_ptr<SerialTransport> CreateSerialTransport();
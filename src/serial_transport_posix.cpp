@@ -0,0 +1,202 @@
+#if !defined(_WIN32)
+
+#include "serial_transport.h"
+
+#include <cerrno>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#if defined(__linux__)
+// termios2 takes any baud rate, its header clashes with <termios.h>
+#include <asm/termbits.h>
+#include <sys/epoll.h>
+#else
+#include <termios.h>
+#include <poll.h>
+#endif
+
+namespace
+{
+
+class PosixSerialTransport : public SerialTransport
+{
+public:
+  PosixSerialTransport();
+  ~PosixSerialTransport() override;
+  bool Open(const std::wstring &port, int baudRate) override;
+  void Close() override;
+  ReadResult StartRead(char *buffer, size_t size, size_t *bytesRead) override;
+  ReadResult WaitRead(int timeoutMs, size_t *bytesRead) override;
+  const std::wstring &LastError() const override;
+private:
+  bool Configure(int baudRate);
+  ReadResult ReadNow(size_t *bytesRead);
+  ReadResult Fail(const wchar_t *what);
+private:
+  int fd_;
+  int epoll_;
+  char *buffer_;
+  size_t size_;
+  std::wstring error_;
+};
+
+PosixSerialTransport::PosixSerialTransport()
+  : fd_(-1)
+  , epoll_(-1)
+  , buffer_(nullptr)
+  , size_(0)
+{
+}
+
+PosixSerialTransport::~PosixSerialTransport()
+{
+  Close();
+}
+
+bool PosixSerialTransport::Open(const std::wstring &port, int baudRate)
+{
+  Close();
+  fd_ = open(std::filesystem::path(port).c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd_ < 0)
+  {
+    return false;
+  }
+  if (!Configure(baudRate))
+  {
+    Close();
+    return false;
+  }
+#if defined(__linux__)
+  epoll_ = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd_;
+  if (epoll_ < 0 || epoll_ctl(epoll_, EPOLL_CTL_ADD, fd_, &ev) != 0)
+  {
+    Close();
+    return false;
+  }
+#endif
+  return true;
+}
+
+bool PosixSerialTransport::Configure(int baudRate)
+{
+  // raw 8N1, no flow control
+#if defined(__linux__)
+  termios2 tio = {};
+  if (ioctl(fd_, TCGETS2, &tio) != 0)
+  {
+    return false;
+  }
+  tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+  tio.c_ispeed = baudRate;
+  tio.c_ospeed = baudRate;
+#else
+  termios tio = {};
+  if (tcgetattr(fd_, &tio) != 0)
+  {
+    return false;
+  }
+  // speed_t is the plain rate on the BSDs and macOS
+  cfsetspeed(&tio, static_cast<speed_t>(baudRate));
+#endif
+  tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+  tio.c_cflag |= CS8 | CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+#if defined(__linux__)
+  return ioctl(fd_, TCSETS2, &tio) == 0;
+#else
+  return tcsetattr(fd_, TCSANOW, &tio) == 0;
+#endif
+}
+
+void PosixSerialTransport::Close()
+{
+  if (epoll_ >= 0)
+  {
+    close(epoll_);
+    epoll_ = -1;
+  }
+  if (fd_ >= 0)
+  {
+    close(fd_);
+    fd_ = -1;
+  }
+  buffer_ = nullptr;
+}
+
+SerialTransport::ReadResult PosixSerialTransport::StartRead(char *buffer, size_t size, size_t *bytesRead)
+{
+  buffer_ = buffer;
+  size_ = size;
+  return ReadNow(bytesRead);
+}
+
+SerialTransport::ReadResult PosixSerialTransport::ReadNow(size_t *bytesRead)
+{
+  const ssize_t n = read(fd_, buffer_, size_);
+  if (n > 0)
+  {
+    *bytesRead = static_cast<size_t>(n);
+    return ReadResult::Data;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+  {
+    return ReadResult::Pending;
+  }
+  if (n == 0)
+  {
+    // hung up, e.g. the other end of a pty was closed
+    errno = EIO;
+  }
+  return Fail(L"read");
+}
+
+SerialTransport::ReadResult PosixSerialTransport::WaitRead(int timeoutMs, size_t *bytesRead)
+{
+#if defined(__linux__)
+  epoll_event ev = {};
+  const int ready = epoll_wait(epoll_, &ev, 1, timeoutMs);
+#else
+  pollfd ev = { fd_, POLLIN, 0 };
+  const int ready = poll(&ev, 1, timeoutMs);
+#endif
+  if (ready < 0)
+  {
+    return errno == EINTR ? ReadResult::Pending : Fail(L"wait");
+  }
+  if (ready == 0)
+  {
+    return ReadResult::Pending;
+  }
+  // a hang up shows as a failing read
+  return ReadNow(bytesRead);
+}
+
+const std::wstring &PosixSerialTransport::LastError() const
+{
+  return error_;
+}
+
+SerialTransport::ReadResult PosixSerialTransport::Fail(const wchar_t *what)
+{
+  const int code = errno;
+  error_ = std::wstring(what) + L" ERROR: " + std::to_wstring(code);
+  return ReadResult::Error;
+}
+
+} // private namespace
+
+std::unique_ptr<SerialTransport> CreateSerialTransport()
+{
+  return std::make_unique<PosixSerialTransport>();
+}
+
+#endif
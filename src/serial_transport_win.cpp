@@ -0,0 +1,140 @@
+#if defined(_WIN32)
+
+#include "serial_transport.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+namespace
+{
+
+class Win32SerialTransport : public SerialTransport
+{
+public:
+  Win32SerialTransport();
+  ~Win32SerialTransport() override;
+  bool Open(const std::wstring &port, int baudRate) override;
+  void Close() override;
+  ReadResult StartRead(char *buffer, size_t size, size_t *bytesRead) override;
+  ReadResult WaitRead(int timeoutMs, size_t *bytesRead) override;
+  const std::wstring &LastError() const override;
+private:
+  ReadResult Fail(const wchar_t *what);
+private:
+  HANDLE handle_;
+  OVERLAPPED ov_;
+  bool pending_;
+  std::wstring error_;
+};
+
+Win32SerialTransport::Win32SerialTransport()
+  : handle_(INVALID_HANDLE_VALUE)
+  , ov_()
+  , pending_(false)
+{
+  ov_.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+}
+
+Win32SerialTransport::~Win32SerialTransport()
+{
+  Close();
+  CloseHandle(ov_.hEvent);
+}
+
+bool Win32SerialTransport::Open(const std::wstring &port, int baudRate)
+{
+  Close();
+  handle_ = CreateFileW(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+  if (handle_ == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  DCB dcb = { 0 };
+  dcb.DCBlength = sizeof(DCB);
+  if (GetCommState(handle_, &dcb))
+  {
+    dcb.BaudRate = baudRate;
+    dcb.ByteSize = 8;
+    dcb.Parity = 0;
+    dcb.StopBits = 0;
+    dcb.fBinary = 1;
+    if (SetCommState(handle_, &dcb))
+    {
+      return true;
+    }
+  }
+  Close();
+  return false;
+}
+
+void Win32SerialTransport::Close()
+{
+  if (handle_ == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+  if (pending_)
+  {
+    // the read must not write into the caller's buffer after this returns
+    DWORD bytesRead = 0;
+    CancelIo(handle_);
+    GetOverlappedResult(handle_, &ov_, &bytesRead, TRUE);
+    pending_ = false;
+  }
+  CloseHandle(handle_);
+  handle_ = INVALID_HANDLE_VALUE;
+}
+
+SerialTransport::ReadResult Win32SerialTransport::StartRead(char *buffer, size_t size, size_t *bytesRead)
+{
+  DWORD n = 0;
+  if (ReadFile(handle_, buffer, static_cast<DWORD>(size), &n, &ov_))
+  {
+    *bytesRead = n;
+    return ReadResult::Data;
+  }
+  if (GetLastError() == ERROR_IO_PENDING)
+  {
+    pending_ = true;
+    return ReadResult::Pending;
+  }
+  return Fail(L"ReadFile");
+}
+
+SerialTransport::ReadResult Win32SerialTransport::WaitRead(int timeoutMs, size_t *bytesRead)
+{
+  if (WaitForSingleObject(ov_.hEvent, timeoutMs) != WAIT_OBJECT_0)
+  {
+    return ReadResult::Pending;
+  }
+  pending_ = false;
+  DWORD n = 0;
+  if (!GetOverlappedResult(handle_, &ov_, &n, FALSE))
+  {
+    return Fail(L"GetOverlappedResult");
+  }
+  *bytesRead = n;
+  return ReadResult::Data;
+}
+
+const std::wstring &Win32SerialTransport::LastError() const
+{
+  return error_;
+}
+
+SerialTransport::ReadResult Win32SerialTransport::Fail(const wchar_t *what)
+{
+  const DWORD code = GetLastError();
+  error_ = std::wstring(what) + L" ERROR: " + std::to_wstring(code);
+  return ReadResult::Error;
+}
+
+} // private namespace
+
+std::unique_ptr<SerialTransport> CreateSerialTransport()
+{
+  return std::make_unique<Win32SerialTransport>();
+}
+
+#endif
@@ -0,0 +1,660 @@
+#include "stdafx.h"
+#include "snapshot.h"
+#include "row_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace
+{
+
+// native byte order, every section starts 8 byte aligned so that the
+// mapping can be read in place:
+// header, a column entry per item, the columns, times, group ids, colors
+const uint32_t snapshotMagic = 0x4E535445;
+const uint32_t snapshotVersion = 1;
+const uint32_t blockRows = 0x10000;
+// more distinct values than this keep a column in blocks
+const size_t maxDictionaryValues = 0x10000;
+
+enum ColumnKind : uint32_t
+{
+  BlockColumn,
+  DictionaryColumn,
+};
+
+struct SnapshotHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t rowCount;
+  uint32_t blockRows;
+  uint32_t columnCount;
+  uint64_t timesOffset;
+  uint64_t groupsOffset;
+  uint64_t colorsOffset;
+  uint64_t colorCount;
+};
+
+struct ColumnEntry
+{
+  uint32_t item;
+  uint32_t kind;
+  uint64_t offset;
+};
+
+// followed by valueCount value ends, the characters and a code per row
+struct DictionaryHeader
+{
+  uint32_t valueCount;
+  uint32_t charCount;
+};
+
+// followed by the characters of the value
+struct ColorRecord
+{
+  uint32_t item;
+  int32_t index;
+  uint32_t bgColor;
+  uint32_t txtColor;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+// UTF-16 units, wchar_t is UTF-16 on Windows
+void AppendUtf16(const std::wstring &value, std::vector<uint16_t> *chars)
+{
+  for (auto c : value)
+  {
+    chars->push_back(static_cast<uint16_t>(c));
+  }
+}
+
+void AssignUtf16(const uint16_t *begin, const uint16_t *end, std::wstring *value)
+{
+  value->assign(begin, end);
+}
+
+template <class T>
+void WriteValues(std::ofstream &out, const T *values, size_t count = 1)
+{
+  out.write(reinterpret_cast<const char *>(values), count * sizeof(T));
+}
+
+uint64_t Align(std::ofstream &out)
+{
+  static const char zeros[8] = {0};
+  const uint64_t offset = static_cast<uint64_t>(out.tellp());
+  if (offset % 8)
+  {
+    out.write(zeros, 8 - offset % 8);
+  }
+  return static_cast<uint64_t>(out.tellp());
+}
+
+bool Fits(uint64_t offset, uint64_t bytes, size_t size)
+{
+  return offset % 8 == 0 && offset <= size && bytes <= size - offset;
+}
+
+} // private namespace
+
+SnapshotWriter::SnapshotWriter(const LogStore &store, std::vector<size_t> rows)
+  : store_(store)
+  , rows_(std::move(rows))
+  , cancel_(nullptr)
+{
+}
+
+void SnapshotWriter::SetGroupIds(std::vector<int> groupIds)
+{
+  groupIds_ = std::move(groupIds);
+}
+
+void SnapshotWriter::AddColor(const SnapshotColor &color)
+{
+  colors_.push_back(color);
+}
+
+void SnapshotWriter::SetProgressCallback(const std::function<void(size_t doneRows, size_t totalRows)> &callback)
+{
+  progress_ = callback;
+}
+
+void SnapshotWriter::SetCancelFlag(const std::atomic<bool> *cancel)
+{
+  cancel_ = cancel;
+}
+
+bool SnapshotWriter::Cancelled() const
+{
+  return cancel_ && cancel_->load();
+}
+
+void SnapshotWriter::Progress(size_t doneRows) const
+{
+  // every column, the times and the group ids go through all rows, the
+  // callback gets the share of that as rows
+  if (progress_ && !rows_.empty())
+  {
+    progress_(doneRows / (static_cast<size_t>(etl::TraceEventDataItem::MAX_ITEM) + 2), rows_.size());
+  }
+}
+
+bool SnapshotWriter::Write(const fs::path &path) const
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out)
+  {
+    return false;
+  }
+  SnapshotHeader header = {0};
+  header.magic = snapshotMagic;
+  header.version = snapshotVersion;
+  header.rowCount = rows_.size();
+  header.blockRows = blockRows;
+  header.columnCount = static_cast<uint32_t>(etl::TraceEventDataItem::MAX_ITEM);
+  std::vector<ColumnEntry> columns(header.columnCount);
+  // the directory is filled in once the offsets are known
+  WriteValues(out, &header);
+  WriteValues(out, columns.data(), columns.size());
+  size_t doneRows = 0;
+  for (uint32_t i = 0; i < header.columnCount; ++i)
+  {
+    if (Cancelled())
+    {
+      return false;
+    }
+    const auto item = static_cast<etl::TraceEventDataItem>(i);
+    columns[i].item = i;
+    columns[i].offset = Align(out);
+    columns[i].kind = WriteDictionary(out, item) ? DictionaryColumn : BlockColumn;
+    if (columns[i].kind == BlockColumn && !WriteBlocks(out, item, doneRows))
+    {
+      return false;
+    }
+    doneRows += rows_.size();
+    Progress(doneRows);
+  }
+  header.timesOffset = Align(out);
+  for (auto row : rows_)
+  {
+    FILETIME ft = {0};
+    store_.GetItemTime(row, &ft);
+    const uint64_t time = (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    WriteValues(out, &time);
+  }
+  doneRows += rows_.size();
+  Progress(doneRows);
+  header.groupsOffset = Align(out);
+  for (auto row : rows_)
+  {
+    const int32_t groupId = row < groupIds_.size() ? groupIds_[row] : 0;
+    WriteValues(out, &groupId);
+  }
+  doneRows += rows_.size();
+  Progress(doneRows);
+  if (Cancelled())
+  {
+    return false;
+  }
+  header.colorsOffset = Align(out);
+  header.colorCount = colors_.size();
+  std::vector<uint16_t> chars;
+  for (auto &&c : colors_)
+  {
+    chars.clear();
+    AppendUtf16(c.value, &chars);
+    const ColorRecord record = { static_cast<uint32_t>(c.item), c.index, c.bgColor, c.txtColor, static_cast<uint32_t>(chars.size()), 0 };
+    WriteValues(out, &record);
+    WriteValues(out, chars.data(), chars.size());
+    Align(out);
+  }
+  out.seekp(0);
+  WriteValues(out, &header);
+  WriteValues(out, columns.data(), columns.size());
+  return out.good();
+}
+
+bool SnapshotWriter::WriteDictionary(std::ofstream &out, etl::TraceEventDataItem item) const
+{
+  std::unordered_map<std::wstring, uint32_t> index;
+  std::vector<const std::wstring *> values;
+  std::vector<uint32_t> codes;
+  codes.reserve(rows_.size());
+  for (auto row : rows_)
+  {
+    auto it = index.emplace(store_.GetItemValue(row, item), static_cast<uint32_t>(values.size()));
+    if (it.second)
+    {
+      values.push_back(&it.first->first);
+      // unique values, like the ID or the message, give up early
+      if (values.size() > maxDictionaryValues || (values.size() > 0x100 && values.size() > codes.size() / 2))
+      {
+        return false;
+      }
+    }
+    codes.push_back(it.first->second);
+  }
+  std::vector<uint32_t> ends;
+  std::vector<uint16_t> chars;
+  for (auto v : values)
+  {
+    AppendUtf16(*v, &chars);
+    ends.push_back(static_cast<uint32_t>(chars.size()));
+  }
+  const DictionaryHeader header = { static_cast<uint32_t>(values.size()), static_cast<uint32_t>(chars.size()) };
+  WriteValues(out, &header);
+  WriteValues(out, ends.data(), ends.size());
+  WriteValues(out, chars.data(), chars.size());
+  Align(out);
+  WriteValues(out, codes.data(), codes.size());
+  return true;
+}
+
+bool SnapshotWriter::WriteBlocks(std::ofstream &out, etl::TraceEventDataItem item, size_t doneRows) const
+{
+  // a table of block offsets, then per block the end of every value and the
+  // characters
+  const size_t blockCount = (rows_.size() + blockRows - 1) / blockRows;
+  const uint64_t table = static_cast<uint64_t>(out.tellp());
+  std::vector<uint64_t> offsets(blockCount);
+  WriteValues(out, offsets.data(), offsets.size());
+  std::vector<uint32_t> ends;
+  std::vector<uint16_t> chars;
+  for (size_t b = 0; b < blockCount; ++b)
+  {
+    if (Cancelled())
+    {
+      return false;
+    }
+    if (b > 0)
+    {
+      Progress(doneRows + b * blockRows);
+    }
+    ends.clear();
+    chars.clear();
+    const size_t last = __min(rows_.size(), (b + 1) * blockRows);
+    for (size_t r = b * blockRows; r < last; ++r)
+    {
+      AppendUtf16(store_.GetItemValue(rows_[r], item), &chars);
+      ends.push_back(static_cast<uint32_t>(chars.size()));
+    }
+    offsets[b] = Align(out);
+    WriteValues(out, ends.data(), ends.size());
+    WriteValues(out, chars.data(), chars.size());
+  }
+  const auto end = out.tellp();
+  out.seekp(table);
+  WriteValues(out, offsets.data(), offsets.size());
+  out.seekp(end);
+  return true;
+}
+
+///////
+
+SnapshotStore::SnapshotStore(const fs::path &path)
+  : path_(path)
+  , blockRows_(blockRows)
+  , fileRows_(0)
+  , times_(nullptr)
+  , groups_(nullptr)
+  , cacheOwner_(RowCache<ItemCount>::NewOwner())
+  , rowCount_(0)
+  , injected_(new std::atomic<InjectedRow *>[MaxInjectChunks])
+{
+  for (auto &c : columns_)
+  {
+    c.present = false;
+    c.codes = nullptr;
+  }
+  for (size_t i = 0; i < MaxInjectChunks; ++i)
+  {
+    injected_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+SnapshotStore::~SnapshotStore()
+{
+  RemoveAllItems();
+}
+
+bool SnapshotStore::Open()
+{
+  if (!file_.Open(path_) || !file_.Data())
+  {
+    return false;
+  }
+  const size_t size = file_.Size();
+  SnapshotHeader header;
+  if (size < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, file_.Data(), sizeof(header));
+  if (header.magic != snapshotMagic || header.version != snapshotVersion || header.blockRows == 0 ||
+      header.columnCount > ItemCount || header.rowCount > size ||
+      !Fits(sizeof(header), header.columnCount * sizeof(ColumnEntry), size) ||
+      !Fits(header.timesOffset, header.rowCount * sizeof(uint64_t), size) ||
+      !Fits(header.groupsOffset, header.rowCount * sizeof(int32_t), size) ||
+      !Fits(header.colorsOffset, 0, size))
+  {
+    return false;
+  }
+  fileRows_ = static_cast<size_t>(header.rowCount);
+  blockRows_ = header.blockRows;
+  times_ = reinterpret_cast<const uint64_t *>(file_.Data() + header.timesOffset);
+  groups_ = reinterpret_cast<const int32_t *>(file_.Data() + header.groupsOffset);
+  std::vector<ColumnEntry> entries(header.columnCount);
+  memcpy(entries.data(), file_.Data() + sizeof(header), entries.size() * sizeof(ColumnEntry));
+  for (auto &&e : entries)
+  {
+    if (e.item >= ItemCount || !ReadColumn(e.item, e.kind, e.offset))
+    {
+      return false;
+    }
+  }
+  if (!ReadColors(header.colorsOffset, header.colorCount))
+  {
+    return false;
+  }
+  rowCount_ = fileRows_;
+  return true;
+}
+
+bool SnapshotStore::ReadColumn(uint32_t item, uint32_t kind, uint64_t offset)
+{
+  const char *data = file_.Data();
+  const size_t size = file_.Size();
+  auto &column = columns_[item];
+  if (column.present)
+  {
+    return false;
+  }
+  if (kind == DictionaryColumn)
+  {
+    DictionaryHeader header;
+    if (!Fits(offset, sizeof(header), size))
+    {
+      return false;
+    }
+    memcpy(&header, data + offset, sizeof(header));
+    const uint64_t endsOffset = offset + sizeof(header);
+    const uint64_t charsOffset = endsOffset + header.valueCount * uint64_t(sizeof(uint32_t));
+    const uint64_t codesOffset = (charsOffset + header.charCount * uint64_t(sizeof(uint16_t)) + 7) & ~uint64_t(7);
+    if (!Fits(codesOffset, fileRows_ * uint64_t(sizeof(uint32_t)), size))
+    {
+      return false;
+    }
+    // the values are few, they are decoded once
+    auto ends = reinterpret_cast<const uint32_t *>(data + endsOffset);
+    auto chars = reinterpret_cast<const uint16_t *>(data + charsOffset);
+    uint32_t begin = 0;
+    column.values.resize(header.valueCount);
+    for (uint32_t v = 0; v < header.valueCount; ++v)
+    {
+      if (ends[v] < begin || ends[v] > header.charCount)
+      {
+        return false;
+      }
+      AssignUtf16(chars + begin, chars + ends[v], &column.values[v]);
+      begin = ends[v];
+    }
+    column.codes = reinterpret_cast<const uint32_t *>(data + codesOffset);
+    for (size_t r = 0; r < fileRows_; ++r)
+    {
+      if (column.codes[r] >= header.valueCount)
+      {
+        return false;
+      }
+    }
+  }
+  else if (kind == BlockColumn)
+  {
+    const size_t blockCount = (fileRows_ + blockRows_ - 1) / blockRows_;
+    if (!Fits(offset, blockCount * uint64_t(sizeof(uint64_t)), size))
+    {
+      return false;
+    }
+    auto table = reinterpret_cast<const uint64_t *>(data + offset);
+    for (size_t b = 0; b < blockCount; ++b)
+    {
+      const size_t rows = __min(fileRows_ - b * blockRows_, blockRows_);
+      if (!Fits(table[b], rows * uint64_t(sizeof(uint32_t)), size))
+      {
+        return false;
+      }
+      auto ends = reinterpret_cast<const uint32_t *>(data + table[b]);
+      uint32_t end = 0;
+      for (size_t r = 0; r < rows; ++r)
+      {
+        if (ends[r] < end)
+        {
+          return false;
+        }
+        end = ends[r];
+      }
+      if (end * uint64_t(sizeof(uint16_t)) > size - table[b] - rows * sizeof(uint32_t))
+      {
+        return false;
+      }
+      column.blocks.push_back(data + table[b]);
+    }
+  }
+  else
+  {
+    return false;
+  }
+  column.present = true;
+  return true;
+}
+
+bool SnapshotStore::ReadColors(uint64_t offset, uint64_t count)
+{
+  const char *data = file_.Data();
+  const size_t size = file_.Size();
+  for (uint64_t i = 0; i < count; ++i)
+  {
+    ColorRecord record;
+    if (!Fits(offset, sizeof(record), size))
+    {
+      return false;
+    }
+    memcpy(&record, data + offset, sizeof(record));
+    offset += sizeof(record);
+    if (record.item >= ItemCount || record.length > (size - offset) / sizeof(uint16_t))
+    {
+      return false;
+    }
+    auto chars = reinterpret_cast<const uint16_t *>(data + offset);
+    SnapshotColor color;
+    color.item = static_cast<etl::TraceEventDataItem>(record.item);
+    AssignUtf16(chars, chars + record.length, &color.value);
+    color.index = record.index;
+    color.bgColor = record.bgColor;
+    color.txtColor = record.txtColor;
+    colors_.push_back(color);
+    offset = (offset + record.length * uint64_t(sizeof(uint16_t)) + 7) & ~uint64_t(7);
+  }
+  return true;
+}
+
+int SnapshotStore::GroupId(size_t row) const
+{
+  return row < fileRows_ ? groups_[row] : 0;
+}
+
+const std::vector<SnapshotColor> &SnapshotStore::Colors() const
+{
+  return colors_;
+}
+
+void SnapshotStore::SetCountCallback(const std::function<void(size_t)> &callback)
+{
+  countCallback_ = callback;
+}
+
+bool SnapshotStore::Start()
+{
+  // nothing to load, the rows are reported once more for the new callback
+  const size_t rowCount = rowCount_;
+  if (countCallback_ && rowCount > 0)
+  {
+    countCallback_(rowCount);
+  }
+  return true;
+}
+
+void SnapshotStore::Stop()
+{
+}
+
+size_t SnapshotStore::GetItemCount() const
+{
+  return rowCount_.load(std::memory_order_acquire);
+}
+
+const std::wstring &SnapshotStore::BlockValue(size_t row, etl::TraceEventDataItem item) const
+{
+  thread_local RowCache<ItemCount> cache;
+  auto &entry = cache.Get(cacheOwner_, row);
+  const size_t i = static_cast<size_t>(item);
+  if (!(entry.decoded & (1u << i)))
+  {
+    const size_t block = row / blockRows_;
+    const size_t r = row % blockRows_;
+    const size_t rows = __min(fileRows_ - block * blockRows_, blockRows_);
+    auto ends = reinterpret_cast<const uint32_t *>(columns_[i].blocks[block]);
+    auto chars = reinterpret_cast<const uint16_t *>(ends + rows);
+    AssignUtf16(chars + (r > 0 ? ends[r - 1] : 0), chars + ends[r], &entry.cells[i]);
+    entry.decoded |= 1u << i;
+  }
+  return entry.cells[i];
+}
+
+const SnapshotStore::InjectedRow &SnapshotStore::Injected(size_t row) const
+{
+  const size_t i = row - fileRows_;
+  return injected_[i / InjectChunkRows].load(std::memory_order_acquire)[i % InjectChunkRows];
+}
+
+const std::wstring &SnapshotStore::GetItemValue(size_t row, etl::TraceEventDataItem item) const
+{
+  static const std::wstring empty;
+  if (row >= GetItemCount() || item >= etl::TraceEventDataItem::MAX_ITEM)
+  {
+    return empty;
+  }
+  const size_t i = static_cast<size_t>(item);
+  if (row >= fileRows_)
+  {
+    return Injected(row).cells[i];
+  }
+  auto &column = columns_[i];
+  if (!column.present)
+  {
+    return empty;
+  }
+  if (column.codes)
+  {
+    return column.values[column.codes[row]];
+  }
+  return BlockValue(row, item);
+}
+
+const wchar_t *SnapshotStore::GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const
+{
+  auto &&s = GetItemValue(row, item);
+  if (length)
+  {
+    *length = s.length();
+  }
+  return s.c_str();
+}
+
+bool SnapshotStore::GetItemTime(size_t row, FILETIME *ft) const
+{
+  if (row >= GetItemCount())
+  {
+    return false;
+  }
+  if (row >= fileRows_)
+  {
+    *ft = Injected(row).time;
+    return true;
+  }
+  // zero for the rows whose store had no time
+  const uint64_t time = times_[row];
+  ft->dwLowDateTime = static_cast<DWORD>(time);
+  ft->dwHighDateTime = static_cast<DWORD>(time >> 32);
+  return time != 0;
+}
+
+const ColumnDictionary *SnapshotStore::Dictionary(etl::TraceEventDataItem) const
+{
+  return nullptr;
+}
+
+void SnapshotStore::ApplyFilters()
+{
+}
+
+void SnapshotStore::RemoveAllItems()
+{
+  std::lock_guard<std::mutex> l(injectLock_);
+  for (size_t i = 0; i < MaxInjectChunks; ++i)
+  {
+    delete[] injected_[i].exchange(nullptr);
+  }
+  for (auto &c : columns_)
+  {
+    c.present = false;
+    c.values.clear();
+    c.codes = nullptr;
+    c.blocks.clear();
+  }
+  rowCount_ = 0;
+  fileRows_ = 0;
+  times_ = nullptr;
+  groups_ = nullptr;
+  cacheOwner_ = RowCache<ItemCount>::NewOwner();
+  file_.Close();
+}
+
+void SnapshotStore::InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values)
+{
+  std::lock_guard<std::mutex> l(injectLock_);
+  const size_t row = rowCount_.load(std::memory_order_relaxed);
+  const size_t i = row - fileRows_;
+  if (i / InjectChunkRows >= MaxInjectChunks)
+  {
+    return;
+  }
+  auto &chunk = injected_[i / InjectChunkRows];
+  if (!chunk.load(std::memory_order_relaxed))
+  {
+    chunk.store(new InjectedRow[InjectChunkRows], std::memory_order_release);
+  }
+  auto &injected = chunk.load(std::memory_order_relaxed)[i % InjectChunkRows];
+  for (auto item = etl::TraceEventDataItem::TraceIndex; item < etl::TraceEventDataItem::MAX_ITEM; ++item)
+  {
+    injected.cells[static_cast<size_t>(item)] = values(item);
+  }
+  auto &index = injected.cells[static_cast<size_t>(etl::TraceEventDataItem::TraceIndex)];
+  if (index.empty())
+  {
+    index = std::to_wstring(row);
+  }
+  auto &time = injected.cells[static_cast<size_t>(etl::TraceEventDataItem::TimeStamp)];
+  if (time.empty())
+  {
+    time = FormatItemTime(ft);
+  }
+  injected.time = ft;
+  rowCount_.store(row + 1, std::memory_order_release);
+  if (countCallback_)
+  {
+    countCallback_(row + 1);
+  }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "log_store.h"
+#include "mapped_file.h"
+
+#include <iosfwd>
+#include <mutex>
+
+// etrace snapshot, the rows of a session together with their groups and the
+// colors picked for values, read in place from a memory mapped file. Every
+// item is a column: low cardinality ones a dictionary and a code per row, the
+// others blocks of UTF-16 values. Raw FILETIME values are kept for the rows
+// whose store had one, the text of the timestamp column is kept as shown.
+
+// Color of a value of a column.
+struct SnapshotColor
+{
+  etl::TraceEventDataItem item;
+  std::wstring value;
+  int index;
+  COLORREF bgColor;
+  COLORREF txtColor;
+};
+
+class SnapshotWriter
+{
+public:
+  // Rows of the store, written in this order.
+  SnapshotWriter(const LogStore &store, std::vector<size_t> rows);
+  // Group id of every row of the store by row, a copy as the view keeps
+  // changing its own, rows past the end have none.
+  void SetGroupIds(std::vector<int> groupIds);
+  void AddColor(const SnapshotColor &color);
+  // Called after each column and block with how far the write got, counted
+  // in rows, and the rows to write.
+  void SetProgressCallback(const std::function<void(size_t doneRows, size_t totalRows)> &callback);
+  // Setting the flag stops a write in progress, which then fails.
+  void SetCancelFlag(const std::atomic<bool> *cancel);
+  bool Write(const fs::path &path) const;
+private:
+  bool Cancelled() const;
+  void Progress(size_t doneRows) const;
+  bool WriteDictionary(std::ofstream &out, etl::TraceEventDataItem item) const;
+  bool WriteBlocks(std::ofstream &out, etl::TraceEventDataItem item, size_t doneRows) const;
+private:
+  const LogStore &store_;
+  std::vector<size_t> rows_;
+  std::vector<int> groupIds_;
+  std::vector<SnapshotColor> colors_;
+  std::function<void(size_t doneRows, size_t totalRows)> progress_;
+  const std::atomic<bool> *cancel_;
+};
+
+class SnapshotStore : public LogStore
+{
+public:
+  explicit SnapshotStore(const fs::path &path);
+  ~SnapshotStore() override;
+  // Maps and checks the file, its rows are there right away.
+  bool Open();
+  int GroupId(size_t row) const;
+  const std::vector<SnapshotColor> &Colors() const;
+  void SetCountCallback(const std::function<void(size_t)> &callback) override;
+  bool Start() override;
+  void Stop() override;
+  size_t GetItemCount() const override;
+  const std::wstring &GetItemValue(size_t row, etl::TraceEventDataItem item) const override;
+  const wchar_t *GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const override;
+  bool GetItemTime(size_t row, FILETIME *ft) const override;
+  // The coded columns of the file are not ColumnDictionaries.
+  const ColumnDictionary *Dictionary(etl::TraceEventDataItem item) const override;
+  void ApplyFilters() override;
+  void RemoveAllItems() override;
+  void InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values) override;
+private:
+  static const size_t ItemCount = static_cast<size_t>(etl::TraceEventDataItem::MAX_ITEM);
+  struct Column
+  {
+    bool present;
+    // dictionary coded
+    std::vector<std::wstring> values;
+    const uint32_t *codes;
+    // otherwise the start of every block
+    std::vector<const char *> blocks;
+  };
+  // a row injected after the snapshot was opened
+  struct InjectedRow
+  {
+    std::wstring cells[ItemCount];
+    FILETIME time;
+  };
+  bool ReadColumn(uint32_t item, uint32_t kind, uint64_t offset);
+  bool ReadColors(uint64_t offset, uint64_t count);
+  const std::wstring &BlockValue(size_t row, etl::TraceEventDataItem item) const;
+  const InjectedRow &Injected(size_t row) const;
+private:
+  static const size_t InjectChunkRows = 0x1000;
+  static const size_t MaxInjectChunks = 0x4000;
+  fs::path path_;
+  MappedFile file_;
+  size_t blockRows_;
+  size_t fileRows_;
+  Column columns_[ItemCount];
+  const uint64_t *times_;
+  const int32_t *groups_;
+  std::vector<SnapshotColor> colors_;
+  uint64_t cacheOwner_;
+  std::function<void(size_t)> countCallback_;
+  std::atomic<size_t> rowCount_;
+  // rows after fileRows_, chunks of InjectChunkRows that never move
+  std::unique_ptr<std::atomic<InjectedRow *>[]> injected_;
+  std::mutex injectLock_;
+};
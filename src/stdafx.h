@@ -29,6 +29,8 @@
 #include <regex>
 #include <map>
 #include <optional>
+#include <memory>
+#include <atomic>
 
 namespace fs = std::tr2::sys;
 
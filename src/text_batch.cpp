@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include "text_batch.h"
+
+TextBatch::TextBatch()
+  : sharedLength_(0)
+  , shared_()
+{
+}
+
+void TextBatch::Clear()
+{
+  text_.resize(sharedLength_);
+  times_.clear();
+  spans_.clear();
+}
+
+void TextBatch::SetShared(etl::TraceEventDataItem item, const std::wstring &text)
+{
+  std::wstring values[ItemCount];
+  for (size_t i = 0; i < ItemCount; ++i)
+  {
+    values[i] = text_.substr(shared_[i].offset, shared_[i].length);
+  }
+  values[static_cast<size_t>(item)] = text;
+  text_.clear();
+  times_.clear();
+  spans_.clear();
+  for (size_t i = 0; i < ItemCount; ++i)
+  {
+    shared_[i] = Append(values[i].c_str(), values[i].length());
+  }
+  sharedLength_ = text_.length();
+}
+
+void TextBatch::AddRecord(const FILETIME &ft)
+{
+  times_.push_back(ft);
+  spans_.insert(spans_.end(), shared_, shared_ + ItemCount);
+}
+
+TextBatch::Span TextBatch::Append(const wchar_t *text, size_t length)
+{
+  Span s = { text_.length(), length };
+  text_.append(text, length);
+  return s;
+}
+
+void TextBatch::SetValue(etl::TraceEventDataItem item, const wchar_t *text, size_t length)
+{
+  if (times_.empty())
+  {
+    return;
+  }
+  spans_[(times_.size() - 1) * ItemCount + static_cast<size_t>(item)] = Append(text, length);
+}
+
+void TextBatch::SetValue(etl::TraceEventDataItem item, const std::wstring &text)
+{
+  SetValue(item, text.c_str(), text.length());
+}
+
+void TextBatch::SetAsciiValue(etl::TraceEventDataItem item, const char *text, size_t length)
+{
+  if (times_.empty())
+  {
+    return;
+  }
+  const size_t offset = text_.length();
+  text_.resize(offset + length);
+  wchar_t *out = &text_[offset];
+  for (size_t i = 0; i < length; ++i)
+  {
+    const auto c = static_cast<unsigned char>(text[i]);
+    out[i] = c < 0x80 ? c : L'?';
+  }
+  spans_[(times_.size() - 1) * ItemCount + static_cast<size_t>(item)] = { offset, length };
+}
+
+size_t TextBatch::Size() const
+{
+  return times_.size();
+}
+
+bool TextBatch::IsEmpty() const
+{
+  return times_.empty();
+}
+
+const FILETIME &TextBatch::Time(size_t record) const
+{
+  return times_[record];
+}
+
+std::wstring TextBatch::Value(size_t record, etl::TraceEventDataItem item) const
+{
+  auto &&s = spans_[record * ItemCount + static_cast<size_t>(item)];
+  return std::wstring(text_.c_str() + s.offset, s.length);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Pre-split records for LogContext::InsertBatch. The column values of all
+// records are spans into one shared buffer, filling a batch costs no
+// allocation once the buffers have grown and looking a value up is an index.
+class TextBatch
+{
+public:
+  TextBatch();
+  // Drops the records, shared values and the buffer capacity are kept.
+  void Clear();
+  // Value every record starts with, e.g. the port name. Drops the records.
+  void SetShared(etl::TraceEventDataItem item, const std::wstring &text);
+  void AddRecord(const FILETIME &ft);
+  // Sets a value of the last record.
+  void SetValue(etl::TraceEventDataItem item, const wchar_t *text, size_t length);
+  void SetValue(etl::TraceEventDataItem item, const std::wstring &text);
+  // Widens 7 bit text, other bytes become '?'.
+  void SetAsciiValue(etl::TraceEventDataItem item, const char *text, size_t length);
+  size_t Size() const;
+  bool IsEmpty() const;
+  const FILETIME &Time(size_t record) const;
+  std::wstring Value(size_t record, etl::TraceEventDataItem item) const;
+private:
+  struct Span
+  {
+    size_t offset;
+    size_t length;
+  };
+  static const size_t ItemCount = static_cast<size_t>(etl::TraceEventDataItem::MAX_ITEM);
+  Span Append(const wchar_t *text, size_t length);
+private:
+  std::wstring text_;
+  // shared values sit at the start of text_ and survive Clear
+  size_t sharedLength_;
+  Span shared_[ItemCount];
+  std::vector<FILETIME> times_;
+  // ItemCount spans per record
+  std::vector<Span> spans_;
+};
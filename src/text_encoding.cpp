@@ -0,0 +1,126 @@
+#include "text_encoding.h"
+
+#include <cstdint>
+#include <cwchar>
+
+void DecodeUtf8(const char *text, size_t length, std::wstring *out)
+{
+  auto p = reinterpret_cast<const uint8_t *>(text);
+  const auto end = p + length;
+  while (p < end)
+  {
+    // runs of ASCII, the bulk of any log, are widened without decoding
+    auto ascii = p;
+    while (ascii < end && *ascii < 0x80)
+    {
+      ++ascii;
+    }
+    if (ascii != p)
+    {
+      const size_t offset = out->length();
+      out->resize(offset + (ascii - p));
+      wchar_t *o = &(*out)[offset];
+      for (; p < ascii; ++p)
+      {
+        *o++ = *p;
+      }
+      continue;
+    }
+    uint32_t cp = *p++;
+    int follow = 0;
+    if (cp < 0xC0 || cp >= 0xF8)
+    {
+      cp = 0xFFFD;
+    }
+    else if (cp >= 0xF0)
+    {
+      cp &= 0x07;
+      follow = 3;
+    }
+    else if (cp >= 0xE0)
+    {
+      cp &= 0x0F;
+      follow = 2;
+    }
+    else
+    {
+      cp &= 0x1F;
+      follow = 1;
+    }
+    for (; follow > 0; --follow)
+    {
+      if (p == end || (*p & 0xC0) != 0x80)
+      {
+        cp = 0xFFFD;
+        break;
+      }
+      cp = cp << 6 | (*p++ & 0x3F);
+    }
+    if (cp > 0x10FFFF)
+    {
+      cp = 0xFFFD;
+    }
+#if WCHAR_MAX == 0xFFFF
+    if (cp > 0xFFFF)
+    {
+      cp -= 0x10000;
+      out->push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+      out->push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+      continue;
+    }
+#endif
+    out->push_back(static_cast<wchar_t>(cp));
+  }
+}
+
+void EncodeUtf8(const wchar_t *text, size_t length, std::string *out)
+{
+  const auto end = text + length;
+  auto p = text;
+  while (p < end)
+  {
+    auto ascii = p;
+    while (ascii < end && static_cast<uint32_t>(*ascii) < 0x80)
+    {
+      ++ascii;
+    }
+    if (ascii != p)
+    {
+      const size_t offset = out->length();
+      out->resize(offset + (ascii - p));
+      char *o = &(*out)[offset];
+      for (; p < ascii; ++p)
+      {
+        *o++ = static_cast<char>(*p);
+      }
+      continue;
+    }
+    uint32_t cp = static_cast<uint32_t>(*p++);
+#if WCHAR_MAX == 0xFFFF
+    if (cp >= 0xD800 && cp < 0xDC00 && p < end && *p >= 0xDC00 && *p < 0xE000)
+    {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (*p++ - 0xDC00);
+    }
+#endif
+    if ((cp >= 0xD800 && cp < 0xE000) || cp > 0x10FFFF)
+    {
+      cp = 0xFFFD;
+    }
+    if (cp < 0x800)
+    {
+      out->push_back(static_cast<char>(0xC0 | cp >> 6));
+    }
+    else if (cp < 0x10000)
+    {
+      out->push_back(static_cast<char>(0xE0 | cp >> 12));
+      out->push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3F)));
+    }
+    else
+    {
+      out->push_back(static_cast<char>(0xF0 | cp >> 18));
+      out->push_back(static_cast<char>(0x80 | (cp >> 12 & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3F)));
+    }
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
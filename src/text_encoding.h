@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Appends UTF-8 text to a wide string, UTF-16 on Windows. Invalid sequences
+// become U+FFFD.
+void DecodeUtf8(const char *text, size_t length, std::wstring *out);
+
+// Appends wide text as UTF-8 to a byte string. Unpaired surrogates become
+// U+FFFD.
+void EncodeUtf8(const wchar_t *text, size_t length, std::string *out);
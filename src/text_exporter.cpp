@@ -0,0 +1,455 @@
+#include "stdafx.h"
+#include "text_exporter.h"
+#include "text_encoding.h"
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace
+{
+
+// like etl::TrimR on the line that starts at lineStart
+void TrimLine(std::string *out, size_t lineStart)
+{
+  size_t end = out->length();
+  while (end > lineStart)
+  {
+    const char c = (*out)[end - 1];
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+    {
+      break;
+    }
+    --end;
+  }
+  out->resize(end);
+  out->append("\r\n");
+}
+
+// value as UTF-8 in a buffer of the formatting thread
+const std::string &Utf8(const wchar_t *value, size_t length)
+{
+  thread_local std::string utf8;
+  utf8.clear();
+  EncodeUtf8(value, length, &utf8);
+  return utf8;
+}
+
+void AppendCsv(const wchar_t *value, size_t length, std::string *out)
+{
+  auto &utf8 = Utf8(value, length);
+  if (utf8.find_first_of(",\"\r\n") == std::string::npos)
+  {
+    out->append(utf8);
+    return;
+  }
+  out->push_back('"');
+  for (char c : utf8)
+  {
+    if (c == '"')
+    {
+      out->push_back('"');
+    }
+    out->push_back(c);
+  }
+  out->push_back('"');
+}
+
+void AppendJson(const wchar_t *value, size_t length, std::string *out)
+{
+  static const char hex[] = "0123456789abcdef";
+  out->push_back('"');
+  for (char c : Utf8(value, length))
+  {
+    switch (c)
+    {
+    case '"':
+      out->append("\\\"");
+      break;
+    case '\\':
+      out->append("\\\\");
+      break;
+    case '\t':
+      out->append("\\t");
+      break;
+    case '\r':
+      out->append("\\r");
+      break;
+    case '\n':
+      out->append("\\n");
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+      {
+        out->append("\\u00");
+        out->push_back(hex[c >> 4]);
+        out->push_back(hex[c & 0xF]);
+      }
+      else
+      {
+        out->push_back(c);
+      }
+    }
+  }
+  out->push_back('"');
+}
+
+// decimal, or hexadecimal with 0x as some providers print ids
+bool AppendNumber(const wchar_t *value, size_t length, std::string *out)
+{
+  if (length > 2 && value[0] == L'0' && (value[1] == L'x' || value[1] == L'X') && length <= 18)
+  {
+    uint64_t n = 0;
+    for (size_t i = 2; i < length; ++i)
+    {
+      const wchar_t c = value[i];
+      int digit = 0;
+      if (c >= L'0' && c <= L'9')
+      {
+        digit = c - L'0';
+      }
+      else if (c >= L'a' && c <= L'f')
+      {
+        digit = c - L'a' + 10;
+      }
+      else if (c >= L'A' && c <= L'F')
+      {
+        digit = c - L'A' + 10;
+      }
+      else
+      {
+        return false;
+      }
+      n = n << 4 | digit;
+    }
+    out->append(std::to_string(n));
+    return true;
+  }
+  const size_t sign = length > 0 && value[0] == L'-' ? 1 : 0;
+  // no leading zeros, JSON would not take them
+  if (length == sign || (value[sign] == L'0' && length > sign + 1))
+  {
+    return false;
+  }
+  for (size_t i = sign; i < length; ++i)
+  {
+    if (value[i] < L'0' || value[i] > L'9')
+    {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < length; ++i)
+  {
+    out->push_back(static_cast<char>(value[i]));
+  }
+  return true;
+}
+
+uint64_t Ticks(const FILETIME &ft)
+{
+  return static_cast<uint64_t>(ft.dwHighDateTime) << 32 | ft.dwLowDateTime;
+}
+
+// ISO 8601 without a zone, the times are local, in quotes for JSON
+bool AppendTime(const FILETIME &ft, bool quoted, std::string *out)
+{
+  SYSTEMTIME st;
+  if (!FileTimeToSystemTime(&ft, &st))
+  {
+    return false;
+  }
+  const uint64_t ticks = Ticks(ft);
+  char buffer[48];
+  int length = snprintf(buffer, sizeof(buffer), "%s%04u-%02u-%02uT%02u:%02u:%02u.", quoted ? "\"" : "",
+                        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+  // milliseconds unless the time is more precise
+  if (ticks % 10000 == 0)
+  {
+    length += snprintf(buffer + length, sizeof(buffer) - length, "%03u", st.wMilliseconds);
+  }
+  else
+  {
+    length += snprintf(buffer + length, sizeof(buffer) - length, "%07u", static_cast<unsigned>(ticks % 10000000));
+  }
+  out->append(buffer, length);
+  if (quoted)
+  {
+    out->push_back('"');
+  }
+  return true;
+}
+
+} // private namespace
+
+bool IsExportRow(const LogStore &store, const ExportRows &rows, size_t row)
+{
+  if (rows.filter && !rows.filter->Passes(row))
+  {
+    return false;
+  }
+  if (rows.timeRange)
+  {
+    FILETIME ft;
+    if (!GetRowTime(store, row, &ft) || Ticks(ft) < rows.fromTime || Ticks(ft) > rows.toTime)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<size_t> SelectExportRows(const LogStore &store, const ExportRows &rows)
+{
+  if (!rows.all)
+  {
+    return rows.listed;
+  }
+  std::vector<size_t> selected;
+  for (size_t row = 0; row < rows.rowCount; ++row)
+  {
+    if (IsExportRow(store, rows, row))
+    {
+      selected.push_back(row);
+    }
+  }
+  return selected;
+}
+
+TextExporter::TextExporter(const LogStore &store, std::vector<ExportField> fields, ExportFormat format)
+  : store_(store)
+  , fields_(std::move(fields))
+  , format_(format)
+  , cancel_(nullptr)
+{
+}
+
+void TextExporter::IncludeHeader(bool include)
+{
+  header_.clear();
+  if (!include || format_ == ExportFormat::JsonLines)
+  {
+    return;
+  }
+  for (auto &&field : fields_)
+  {
+    if (format_ == ExportFormat::Csv)
+    {
+      if (&field != &fields_.front())
+      {
+        header_ += ',';
+      }
+      AppendCsv(field.name.c_str(), field.name.length(), &header_);
+      continue;
+    }
+    if (!header_.empty())
+    {
+      header_ += '\t';
+    }
+    EncodeUtf8(field.name.c_str(), field.name.length(), &header_);
+  }
+  if (format_ == ExportFormat::Csv)
+  {
+    header_.append("\r\n");
+  }
+  else
+  {
+    TrimLine(&header_, 0);
+  }
+}
+
+void TextExporter::SetProgressCallback(const std::function<void(size_t doneRows, size_t totalRows)> &callback)
+{
+  progress_ = callback;
+}
+
+void TextExporter::SetCancelFlag(const std::atomic<bool> *cancel)
+{
+  cancel_ = cancel;
+}
+
+void TextExporter::FormatText(size_t row, std::string *out) const
+{
+  const size_t lineStart = out->length();
+  for (auto &&field : fields_)
+  {
+    // like the per line export, leading empty values take no field
+    if (out->length() != lineStart)
+    {
+      out->push_back('\t');
+    }
+    size_t length = 0;
+    auto value = store_.GetItemValue(row, field.item, &length);
+    EncodeUtf8(value, length, out);
+  }
+  TrimLine(out, lineStart);
+}
+
+void TextExporter::FormatCsv(size_t row, std::string *out) const
+{
+  for (auto &&field : fields_)
+  {
+    if (&field != &fields_.front())
+    {
+      out->push_back(',');
+    }
+    size_t length = 0;
+    auto value = store_.GetItemValue(row, field.item, &length);
+    if (!AppendTyped(field, row, value, length, out))
+    {
+      AppendCsv(value, length, out);
+    }
+  }
+  out->append("\r\n");
+}
+
+void TextExporter::FormatJson(size_t row, std::string *out) const
+{
+  out->push_back('{');
+  for (auto &&field : fields_)
+  {
+    if (&field != &fields_.front())
+    {
+      out->push_back(',');
+    }
+    AppendJson(field.name.c_str(), field.name.length(), out);
+    out->push_back(':');
+    size_t length = 0;
+    auto value = store_.GetItemValue(row, field.item, &length);
+    if (length == 0 && field.type != ExportField::Type::Text)
+    {
+      out->append("null");
+    }
+    else if (!AppendTyped(field, row, value, length, out))
+    {
+      AppendJson(value, length, out);
+    }
+  }
+  out->append("}\n");
+}
+
+bool TextExporter::AppendTyped(const ExportField &field, size_t row, const wchar_t *value, size_t length, std::string *out) const
+{
+  switch (field.type)
+  {
+  case ExportField::Type::Number:
+    return AppendNumber(value, length, out);
+  case ExportField::Type::Time:
+  {
+    FILETIME ft;
+    if (field.item == etl::TraceEventDataItem::TimeStamp ? !GetRowTime(store_, row, &ft) : !ParseItemTime(value, length, &ft))
+    {
+      return false;
+    }
+    return AppendTime(ft, format_ == ExportFormat::JsonLines, out);
+  }
+  default:
+    return false;
+  }
+}
+
+void TextExporter::FormatRows(const ExportRows &rows, size_t first, size_t count, std::string *out) const
+{
+  for (size_t i = first; i < first + count; ++i)
+  {
+    const size_t row = rows.all ? i : rows.listed[i];
+    if (rows.all && !IsExportRow(store_, rows, row))
+    {
+      continue;
+    }
+    switch (format_)
+    {
+    case ExportFormat::Csv:
+      FormatCsv(row, out);
+      break;
+    case ExportFormat::JsonLines:
+      FormatJson(row, out);
+      break;
+    default:
+      FormatText(row, out);
+    }
+  }
+}
+
+bool TextExporter::Write(FILE *fh, const ExportRows &rows) const
+{
+  return Write([fh](const std::string &text)
+  {
+    return fwrite(text.data(), 1, text.length(), fh) == text.length();
+  }, rows);
+}
+
+bool TextExporter::Write(const std::function<bool(const std::string &text)> &output, const ExportRows &rows) const
+{
+  const auto cancelled = [this]()
+  {
+    return cancel_ && cancel_->load();
+  };
+  if (!header_.empty() && !output(header_))
+  {
+    return false;
+  }
+  const size_t total = rows.all ? rows.rowCount : rows.listed.size();
+  const size_t count = (total + BlockRows - 1) / BlockRows;
+  std::vector<std::string> formatted(count);
+  std::vector<bool> ready(count, false);
+  // buffers already written, formatting reuses their memory
+  std::vector<std::string> spare;
+  std::mutex formattedLock;
+  std::condition_variable formattedReady;
+  bool ok = true;
+  const unsigned cores = std::thread::hardware_concurrency();
+  ThreadPool pool(cores > 1 ? cores - 1 : 1);
+  const size_t window = 2 * pool.ThreadCount();
+  size_t submitted = 0;
+  const auto submit = [&](size_t next)
+  {
+    for (; submitted < count && submitted < next + window; ++submitted)
+    {
+      pool.Submit([&, i = submitted]()
+      {
+        std::string buffer;
+        {
+          std::lock_guard<std::mutex> l(formattedLock);
+          if (!spare.empty())
+          {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+          }
+        }
+        buffer.clear();
+        const size_t first = i * BlockRows;
+        if (!cancelled())
+        {
+          FormatRows(rows, first, __min(BlockRows, total - first), &buffer);
+        }
+        std::lock_guard<std::mutex> l(formattedLock);
+        formatted[i] = std::move(buffer);
+        ready[i] = true;
+        formattedReady.notify_all();
+      });
+    }
+  };
+  submit(0);
+  for (size_t next = 0; next < count && ok; ++next)
+  {
+    std::string buffer;
+    {
+      std::unique_lock<std::mutex> l(formattedLock);
+      formattedReady.wait(l, [&]() { return ready[next]; });
+      buffer = std::move(formatted[next]);
+    }
+    ok = !cancelled() && output(buffer);
+    {
+      std::lock_guard<std::mutex> l(formattedLock);
+      spare.push_back(std::move(buffer));
+    }
+    if (ok && progress_)
+    {
+      progress_(__min((next + 1) * BlockRows, total), total);
+    }
+    submit(next + 1);
+  }
+  // blocks still being formatted after a failed write finish before the
+  // pool and what they write to are gone
+  return ok;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "log_store.h"
+#include "filter_evaluator.h"
+
+#include <atomic>
+#include <cstdio>
+
+enum class ExportFormat
+{
+  // tab separated, the layout a TextLogStore reads back
+  Text,
+  Csv,
+  // one JSON object per row
+  JsonLines,
+};
+
+// Column of an export. CSV and JSON write typed values as numbers and ISO
+// timestamps, values that do not parse as such stay text.
+struct ExportField
+{
+  enum class Type
+  {
+    Text,
+    Number,
+    Time,
+  };
+  std::wstring name;
+  etl::TraceEventDataItem item;
+  Type type;
+};
+
+// Rows an export covers: the listed rows in their order, or every row below
+// rowCount that passes the filter and lies in the time range, when set.
+struct ExportRows
+{
+  std::vector<size_t> listed;
+  bool all = false;
+  size_t rowCount = 0;
+  std::shared_ptr<const FilterEvaluator> filter;
+  bool timeRange = false;
+  // FILETIME ticks, both included
+  uint64_t fromTime = 0;
+  uint64_t toTime = 0;
+};
+
+// Whether a row below rows.rowCount passes the filter and time range.
+bool IsExportRow(const LogStore &store, const ExportRows &rows, size_t row);
+// Rows an export covers, in order, e.g. for a snapshot.
+std::vector<size_t> SelectExportRows(const LogStore &store, const ExportRows &rows);
+
+// Writes rows of a store as UTF-8 text. Blocks of rows are selected and
+// formatted on all cores but one, which is left to capturing and the UI, each
+// block into a buffer of its own, and the buffers are written in row order
+// with one large write each. Only a window of blocks is formatted ahead of
+// the one being written.
+class TextExporter
+{
+public:
+  TextExporter(const LogStore &store, std::vector<ExportField> fields, ExportFormat format = ExportFormat::Text);
+  // Text and CSV start with a line of the field names.
+  void IncludeHeader(bool include);
+  // Called by the writing thread after each block with the rows gone through
+  // so far, selected or not, and all rows to go through.
+  void SetProgressCallback(const std::function<void(size_t doneRows, size_t totalRows)> &callback);
+  // Setting the flag stops a write in progress, which then fails.
+  void SetCancelFlag(const std::atomic<bool> *cancel);
+  bool Write(FILE *fh, const ExportRows &rows) const;
+  // Hands the text over in blocks in order, returning false stops the write.
+  bool Write(const std::function<bool(const std::string &text)> &output, const ExportRows &rows) const;
+private:
+  void FormatRows(const ExportRows &rows, size_t first, size_t count, std::string *out) const;
+  void FormatText(size_t row, std::string *out) const;
+  void FormatCsv(size_t row, std::string *out) const;
+  void FormatJson(size_t row, std::string *out) const;
+  bool AppendTyped(const ExportField &field, size_t row, const wchar_t *value, size_t length, std::string *out) const;
+private:
+  static const size_t BlockRows = 0x4000;
+  const LogStore &store_;
+  std::vector<ExportField> fields_;
+  ExportFormat format_;
+  std::string header_;
+  std::function<void(size_t doneRows, size_t totalRows)> progress_;
+  const std::atomic<bool> *cancel_;
+};
@@ -0,0 +1,904 @@
+#include "stdafx.h"
+#include "text_log_store.h"
+#include "line_framer.h"
+#include "text_encoding.h"
+#include "thread_pool.h"
+#include "row_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace
+{
+
+// large enough to keep a core busy for a while, small enough for the first
+// rows to show up right away, lazy line offsets within a chunk fit 32 bits
+const size_t chunkBytes = 0x400000;
+
+// index next to a lazily loaded text log, in native byte order:
+// header, the item of every field, the chunks, the line offsets of all rows,
+// then per coded item its values as byte ranges of the log and its codes
+const uint32_t indexMagic = 0x58495445;
+const uint32_t indexVersion = 1;
+
+struct IndexHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fileSize;
+  int64_t writeTime;
+  uint32_t fieldCount;
+  uint32_t minFields;
+  uint32_t codedCount;
+  uint32_t chunkCount;
+  uint64_t rowCount;
+};
+
+struct IndexChunk
+{
+  uint64_t fileOffset;
+  uint64_t rowCount;
+};
+
+struct IndexDictionary
+{
+  uint32_t item;
+  uint32_t valueCount;
+  uint64_t codedRows;
+};
+
+struct IndexValue
+{
+  uint64_t begin;
+  uint64_t end;
+};
+
+class IndexReader
+{
+public:
+  IndexReader(const char *data, size_t size)
+    : p_(data)
+    , end_(data + size)
+  {
+  }
+
+  template <class T>
+  bool Read(T *values, size_t count = 1)
+  {
+    if (static_cast<size_t>(end_ - p_) / sizeof(T) < count)
+    {
+      return false;
+    }
+    if (count > 0)
+    {
+      memcpy(values, p_, count * sizeof(T));
+    }
+    p_ += count * sizeof(T);
+    return true;
+  }
+
+  bool AtEnd() const
+  {
+    return p_ == end_;
+  }
+private:
+  const char *p_;
+  const char *end_;
+};
+
+template <class T>
+void Write(std::ofstream &out, const T *values, size_t count = 1)
+{
+  out.write(reinterpret_cast<const char *>(values), count * sizeof(T));
+}
+
+bool LastWriteTime(const fs::path &path, int64_t *time)
+{
+  std::error_code ec;
+  *time = static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+  return !ec;
+}
+
+std::vector<std::wstring> SplitTabs(const std::wstring &line)
+{
+  std::vector<std::wstring> fields;
+  size_t begin = 0;
+  for (size_t tab = line.find(L'\t'); tab != std::wstring::npos; tab = line.find(L'\t', begin))
+  {
+    fields.push_back(line.substr(begin, tab - begin));
+    begin = tab + 1;
+  }
+  fields.push_back(line.substr(begin));
+  return fields;
+}
+
+} // private namespace
+
+TextLogStore::TextLogStore(const fs::path &path, const Columns &columns, bool lazy,
+                           const std::vector<etl::TraceEventDataItem> &codedItems)
+  : path_(path)
+  , minFields_(columns.size())
+  , lazy_(lazy)
+  , cacheOwner_(RowCache<ItemCount>::NewOwner())
+  , nextChunk_(0)
+  , stopLoading_(false)
+  , chunks_(new std::atomic<Chunk *>[MaxChunks])
+  , chunkCount_(0)
+  , rowCount_(0)
+  , loading_(true)
+  , injectChunk_(nullptr)
+{
+  for (auto &&c : columns)
+  {
+    headerNames_.push_back(c.first);
+    fields_.push_back(c.second);
+  }
+  for (size_t i = 0; i < MaxChunks; ++i)
+  {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+  for (auto &slot : codedSlot_)
+  {
+    slot = -1;
+  }
+  // the cells of an eager store are there already
+  if (lazy_)
+  {
+    for (auto item : codedItems)
+    {
+      codedSlot_[static_cast<size_t>(item)] = static_cast<int>(codedItems_.size());
+      codedItems_.push_back(item);
+      dictionaries_.push_back(std::make_unique<ColumnDictionary>());
+    }
+    valueRanges_.resize(codedItems_.size());
+  }
+}
+
+TextLogStore::~TextLogStore()
+{
+  RemoveAllItems();
+}
+
+void TextLogStore::SetCountCallback(const std::function<void(size_t)> &callback)
+{
+  countCallback_ = callback;
+}
+
+bool TextLogStore::Start()
+{
+  {
+    std::lock_guard<std::mutex> l(publishLock_);
+    if (!loading_ || loader_)
+    {
+      return true;
+    }
+  }
+  if (!file_.IsOpen())
+  {
+    if (!file_.Open(path_))
+    {
+      std::lock_guard<std::mutex> l(publishLock_);
+      loading_ = false;
+      return false;
+    }
+    if (!lazy_ || !ReadIndex())
+    {
+      PlanChunks();
+    }
+  }
+  stopLoading_ = false;
+  loader_ = std::make_unique<std::thread>([this]()
+  {
+    Load();
+  });
+  return true;
+}
+
+void TextLogStore::Stop()
+{
+  if (!loader_)
+  {
+    return;
+  }
+  stopLoading_ = true;
+  loader_->join();
+  loader_.reset();
+}
+
+void TextLogStore::PlanChunks()
+{
+  const char *data = file_.Data();
+  const size_t size = file_.Size();
+  size_t begin = 0;
+  // a header line, as written by the export, gives the field order
+  const size_t firstLineEnd = FindByte(data, data + size, '\n') - data;
+  std::wstring line;
+  DecodeUtf8(data, firstLineEnd, &line);
+  if (!line.empty() && line.back() == L'\r')
+  {
+    line.pop_back();
+  }
+  auto names = SplitTabs(line);
+  std::vector<etl::TraceEventDataItem> fields;
+  for (auto &&n : names)
+  {
+    auto it = std::find(headerNames_.begin(), headerNames_.end(), n);
+    if (it == headerNames_.end())
+    {
+      break;
+    }
+    fields.push_back(fields_[it - headerNames_.begin()]);
+  }
+  if (names.size() > 1 && fields.size() == names.size())
+  {
+    fields_ = fields;
+    minFields_ = __min(2, fields_.size());
+    begin = firstLineEnd + 1;
+  }
+  while (begin < size)
+  {
+    size_t end = __min(begin + chunkBytes, size);
+    if (end < size)
+    {
+      end = FindByte(data + end, data + size, '\n') - data;
+      end = __min(end + 1, size);
+    }
+    plan_.push_back({ begin, end });
+    begin = end;
+  }
+}
+
+void TextLogStore::Load()
+{
+  const size_t count = plan_.size();
+  const bool fromIndex = !indexed_.empty();
+  std::vector<std::unique_ptr<Chunk>> parsed(count);
+  std::mutex parsedLock;
+  std::condition_variable parsedReady;
+  {
+    ThreadPool pool;
+    // only a window of chunks ahead of the next one to publish is parsed, it
+    // bounds the memory of chunks waiting for their turn
+    const size_t window = 2 * pool.ThreadCount();
+    size_t submitted = nextChunk_;
+    const auto submit = [&]()
+    {
+      for (; submitted < count && submitted < nextChunk_ + window; ++submitted)
+      {
+        if (fromIndex && indexed_[submitted])
+        {
+          continue;
+        }
+        pool.Submit([&, i = submitted]()
+        {
+          auto chunk = std::make_unique<Chunk>();
+          ParseChunk(plan_[i], chunk.get());
+          std::lock_guard<std::mutex> l(parsedLock);
+          parsed[i] = std::move(chunk);
+          parsedReady.notify_all();
+        });
+      }
+    };
+    submit();
+    while (nextChunk_ < count)
+    {
+      std::unique_ptr<Chunk> chunk;
+      if (fromIndex && indexed_[nextChunk_])
+      {
+        if (stopLoading_)
+        {
+          break;
+        }
+        chunk = std::move(indexed_[nextChunk_]);
+      }
+      else
+      {
+        std::unique_lock<std::mutex> l(parsedLock);
+        parsedReady.wait(l, [&]() { return parsed[nextChunk_] || stopLoading_; });
+        // a chunk cut short by the stop request must not be published
+        if (stopLoading_)
+        {
+          break;
+        }
+        chunk = std::move(parsed[nextChunk_]);
+      }
+      Publish(std::move(chunk));
+      ++nextChunk_;
+      submit();
+    }
+  }
+  if (nextChunk_ < count)
+  {
+    return;
+  }
+  size_t fileChunks = 0;
+  {
+    std::lock_guard<std::mutex> l(publishLock_);
+    loading_ = false;
+    fileChunks = chunkCount_;
+    for (size_t i = 0; i < pendingTimes_.size(); ++i)
+    {
+      AppendRow(pendingTimes_[i], &pendingCells_[i * ItemCount]);
+    }
+    pendingCells_.clear();
+    pendingTimes_.clear();
+  }
+  if (lazy_ && !fromIndex)
+  {
+    WriteIndex(fileChunks);
+  }
+}
+
+void TextLogStore::ParseChunk(const Range &range, Chunk *chunk) const
+{
+  const char *begin = file_.Data() + range.begin;
+  const char *p = begin;
+  const char *end = file_.Data() + range.end;
+  chunk->rowCount = 0;
+  chunk->fileOffset = range.begin;
+  // lazy chunks code their items right away, on all cores, and leave only
+  // the mapping to the codes of the whole file to Publish
+  const size_t coded = codedItems_.size();
+  std::vector<std::unordered_map<std::string_view, uint32_t>> localCodes(coded);
+  chunk->values.resize(coded);
+  std::string_view fields[ItemCount];
+  while (p < end)
+  {
+    if (chunk->rowCount % 0x400 == 0 && stopLoading_)
+    {
+      return;
+    }
+    const char *nl = FindByte(p, end, '\n');
+    size_t length = nl - p;
+    if (length > 0 && p[length - 1] == '\r')
+    {
+      --length;
+    }
+    if (length > 0 && lazy_)
+    {
+      chunk->lines.push_back(static_cast<uint32_t>(p - begin));
+      if (coded > 0)
+      {
+        SplitLine(p, length, fields);
+      }
+      for (size_t k = 0; k < coded; ++k)
+      {
+        auto &&text = fields[static_cast<size_t>(codedItems_[k])];
+        auto code = localCodes[k].emplace(text, static_cast<uint32_t>(chunk->values[k].size()));
+        if (code.second)
+        {
+          chunk->values[k].push_back(text);
+        }
+        chunk->codes.push_back(code.first->second);
+      }
+      ++chunk->rowCount;
+    }
+    else if (length > 0)
+    {
+      chunk->cells.resize(chunk->cells.size() + ItemCount);
+      ParseLine(p, length, &chunk->cells[chunk->rowCount * ItemCount]);
+      ++chunk->rowCount;
+    }
+    p = nl + 1;
+  }
+}
+
+void TextLogStore::SplitLine(const char *line, size_t length, std::string_view *fields) const
+{
+  for (size_t i = 0; i < ItemCount; ++i)
+  {
+    fields[i] = std::string_view();
+  }
+  // count the fields first, a line with too few of them is free text
+  const char *end = line + length;
+  size_t tabs = 0;
+  for (const char *t = FindByte(line, end, '\t'); t != end && tabs + 1 < minFields_; t = FindByte(t + 1, end, '\t'))
+  {
+    ++tabs;
+  }
+  if (tabs + 1 < minFields_)
+  {
+    fields[static_cast<size_t>(etl::TraceEventDataItem::Message)] = std::string_view(line, length);
+    return;
+  }
+  const char *p = line;
+  for (size_t f = 0; f < fields_.size() && p <= end; ++f)
+  {
+    // the last field takes the rest of the line, tabs and all
+    const char *fieldEnd = f + 1 < fields_.size() ? FindByte(p, end, '\t') : end;
+    fields[static_cast<size_t>(fields_[f])] = std::string_view(p, fieldEnd - p);
+    p = fieldEnd + 1;
+  }
+}
+
+void TextLogStore::ParseLine(const char *line, size_t length, std::wstring *cells) const
+{
+  std::string_view fields[ItemCount];
+  SplitLine(line, length, fields);
+  for (size_t i = 0; i < ItemCount; ++i)
+  {
+    DecodeUtf8(fields[i].data(), fields[i].size(), &cells[i]);
+  }
+}
+
+void TextLogStore::Publish(std::unique_ptr<Chunk> chunk)
+{
+  std::lock_guard<std::mutex> l(publishLock_);
+  const size_t chunkCount = chunkCount_.load(std::memory_order_relaxed);
+  if (chunk->rowCount == 0 || chunkCount == MaxChunks)
+  {
+    return;
+  }
+  const size_t rowCount = rowCount_.load(std::memory_order_relaxed);
+  chunk->firstRow = rowCount;
+  CodeChunk(chunk.get());
+  chunks_[chunkCount].store(chunk.get(), std::memory_order_release);
+  chunkCount_.store(chunkCount + 1, std::memory_order_release);
+  rowCount_.store(rowCount + chunk->rowCount, std::memory_order_release);
+  chunk.release();
+  if (countCallback_)
+  {
+    countCallback_(rowCount_);
+  }
+}
+
+void TextLogStore::CodeChunk(Chunk *chunk)
+{
+  // chunk codes become file codes, the values keep their order of first
+  // appearance in the file like the dictionaries of the view
+  const size_t coded = chunk->values.size();
+  std::vector<uint32_t> fileCodes;
+  std::wstring value;
+  for (size_t k = 0; k < coded; ++k)
+  {
+    auto &dictionary = *dictionaries_[k];
+    // full, or filled from the index
+    if (dictionary.CodedRows() != chunk->firstRow)
+    {
+      continue;
+    }
+    auto &&values = chunk->values[k];
+    fileCodes.resize(values.size());
+    bool full = false;
+    for (size_t v = 0; v < values.size() && !full; ++v)
+    {
+      value.clear();
+      DecodeUtf8(values[v].data(), values[v].size(), &value);
+      bool added = false;
+      full = !dictionary.Intern(value, &fileCodes[v], &added);
+      if (added)
+      {
+        const size_t begin = values[v].empty() ? 0 : values[v].data() - file_.Data();
+        valueRanges_[k].push_back({ begin, begin + values[v].size() });
+      }
+    }
+    for (size_t r = 0; r < chunk->rowCount && !full; ++r)
+    {
+      dictionary.AppendCode(chunk->firstRow + r, fileCodes[chunk->codes[r * coded + k]]);
+    }
+  }
+  std::vector<std::vector<std::string_view>>().swap(chunk->values);
+  std::vector<uint32_t>().swap(chunk->codes);
+}
+
+void TextLogStore::InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values)
+{
+  std::wstring cells[ItemCount];
+  for (auto item = etl::TraceEventDataItem::TraceIndex; item < etl::TraceEventDataItem::MAX_ITEM; ++item)
+  {
+    cells[static_cast<size_t>(item)] = values(item);
+  }
+  auto &time = cells[static_cast<size_t>(etl::TraceEventDataItem::TimeStamp)];
+  if (time.empty())
+  {
+    time = FormatItemTime(ft);
+  }
+  std::lock_guard<std::mutex> l(publishLock_);
+  if (loading_)
+  {
+    // the rows of the file come first
+    for (auto &c : cells)
+    {
+      pendingCells_.push_back(std::move(c));
+    }
+    pendingTimes_.push_back(ft);
+    return;
+  }
+  AppendRow(ft, cells);
+}
+
+void TextLogStore::AppendRow(const FILETIME &ft, std::wstring *cells)
+{
+  // publishLock_ is held
+  const size_t rowCount = rowCount_.load(std::memory_order_relaxed);
+  if (!injectChunk_ || injectChunk_->rowCount == InjectChunkRows)
+  {
+    const size_t chunkCount = chunkCount_.load(std::memory_order_relaxed);
+    if (chunkCount == MaxChunks)
+    {
+      return;
+    }
+    // the cells are allocated up front, a published row never moves
+    injectChunk_ = new Chunk();
+    injectChunk_->firstRow = rowCount;
+    injectChunk_->rowCount = 0;
+    injectChunk_->cells.resize(InjectChunkRows * ItemCount);
+    injectChunk_->times.resize(InjectChunkRows);
+    chunks_[chunkCount].store(injectChunk_, std::memory_order_release);
+    chunkCount_.store(chunkCount + 1, std::memory_order_release);
+  }
+  auto row = &injectChunk_->cells[injectChunk_->rowCount * ItemCount];
+  for (size_t i = 0; i < ItemCount; ++i)
+  {
+    row[i] = std::move(cells[i]);
+  }
+  auto &index = row[static_cast<size_t>(etl::TraceEventDataItem::TraceIndex)];
+  if (index.empty())
+  {
+    index = std::to_wstring(rowCount);
+  }
+  injectChunk_->times[injectChunk_->rowCount] = ft;
+  ++injectChunk_->rowCount;
+  rowCount_.store(rowCount + 1, std::memory_order_release);
+  if (countCallback_)
+  {
+    countCallback_(rowCount + 1);
+  }
+}
+
+const TextLogStore::Chunk *TextLogStore::FindChunk(size_t row) const
+{
+  // last chunk starting at or before row
+  size_t lo = 0;
+  size_t hi = chunkCount_.load(std::memory_order_acquire);
+  while (hi - lo > 1)
+  {
+    const size_t mid = (lo + hi) / 2;
+    if (chunks_[mid].load(std::memory_order_acquire)->firstRow <= row)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return chunks_[lo].load(std::memory_order_acquire);
+}
+
+const std::wstring &TextLogStore::ParsedItem(const Chunk &chunk, size_t row, etl::TraceEventDataItem item) const
+{
+  thread_local RowCache<ItemCount> cache;
+  auto &entry = cache.Get(cacheOwner_, row);
+  const size_t i = static_cast<size_t>(item);
+  if (!(entry.decoded & (1u << i)))
+  {
+    const char *line = file_.Data() + chunk.fileOffset + chunk.lines[row - chunk.firstRow];
+    size_t length = FindByte(line, file_.Data() + file_.Size(), '\n') - line;
+    if (length > 0 && line[length - 1] == '\r')
+    {
+      --length;
+    }
+    std::string_view fields[ItemCount];
+    SplitLine(line, length, fields);
+    DecodeUtf8(fields[i].data(), fields[i].size(), &entry.cells[i]);
+    entry.decoded |= 1u << i;
+  }
+  return entry.cells[i];
+}
+
+size_t TextLogStore::GetItemCount() const
+{
+  return rowCount_.load(std::memory_order_acquire);
+}
+
+const std::wstring &TextLogStore::GetItemValue(size_t row, etl::TraceEventDataItem item) const
+{
+  static const std::wstring empty;
+  if (row >= GetItemCount() || item >= etl::TraceEventDataItem::MAX_ITEM)
+  {
+    return empty;
+  }
+  auto chunk = FindChunk(row);
+  if (!chunk->cells.empty())
+  {
+    return chunk->cells[(row - chunk->firstRow) * ItemCount + static_cast<size_t>(item)];
+  }
+  const int slot = codedSlot_[static_cast<size_t>(item)];
+  uint32_t code = 0;
+  if (slot >= 0 && dictionaries_[slot]->Code(row, &code))
+  {
+    return dictionaries_[slot]->Value(code);
+  }
+  return ParsedItem(*chunk, row, item);
+}
+
+const wchar_t *TextLogStore::GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const
+{
+  auto &&s = GetItemValue(row, item);
+  if (length)
+  {
+    *length = s.length();
+  }
+  return s.c_str();
+}
+
+bool TextLogStore::GetItemTime(size_t row, FILETIME *ft) const
+{
+  if (row >= GetItemCount())
+  {
+    return false;
+  }
+  auto chunk = FindChunk(row);
+  if (chunk->times.empty())
+  {
+    return false;
+  }
+  *ft = chunk->times[row - chunk->firstRow];
+  return true;
+}
+
+const ColumnDictionary *TextLogStore::Dictionary(etl::TraceEventDataItem item) const
+{
+  const int slot = codedSlot_[static_cast<size_t>(item)];
+  return slot >= 0 ? dictionaries_[slot].get() : nullptr;
+}
+
+void TextLogStore::ApplyFilters()
+{
+}
+
+void TextLogStore::RemoveAllItems()
+{
+  Stop();
+  std::lock_guard<std::mutex> l(publishLock_);
+  for (size_t i = 0; i < chunkCount_; ++i)
+  {
+    delete chunks_[i].exchange(nullptr);
+  }
+  chunkCount_ = 0;
+  rowCount_ = 0;
+  injectChunk_ = nullptr;
+  pendingCells_.clear();
+  pendingTimes_.clear();
+  indexed_.clear();
+  for (size_t k = 0; k < dictionaries_.size(); ++k)
+  {
+    dictionaries_[k]->Clear();
+    valueRanges_[k].clear();
+  }
+  loading_ = false;
+  cacheOwner_ = RowCache<ItemCount>::NewOwner();
+  file_.Close();
+}
+
+fs::path TextLogStore::IndexPath() const
+{
+  auto path = path_;
+  path += L".etidx";
+  return path;
+}
+
+bool TextLogStore::ReadIndex()
+{
+  int64_t writeTime = 0;
+  MappedFile index;
+  if (!LastWriteTime(path_, &writeTime) || !index.Open(IndexPath()) || !index.Data())
+  {
+    return false;
+  }
+  IndexReader in(index.Data(), index.Size());
+  IndexHeader header;
+  if (!in.Read(&header) || header.magic != indexMagic || header.version != indexVersion ||
+      header.fileSize != file_.Size() || header.writeTime != writeTime ||
+      header.fieldCount == 0 || header.fieldCount > ItemCount ||
+      header.codedCount != codedItems_.size() || header.chunkCount > MaxChunks)
+  {
+    return false;
+  }
+  std::vector<uint32_t> fieldItems(header.fieldCount);
+  if (!in.Read(fieldItems.data(), fieldItems.size()))
+  {
+    return false;
+  }
+  std::vector<etl::TraceEventDataItem> fields;
+  for (auto f : fieldItems)
+  {
+    if (f >= ItemCount)
+    {
+      return false;
+    }
+    fields.push_back(static_cast<etl::TraceEventDataItem>(f));
+  }
+  std::vector<IndexChunk> chunks(header.chunkCount);
+  if (!in.Read(chunks.data(), chunks.size()))
+  {
+    return false;
+  }
+  std::vector<Range> plan;
+  std::vector<std::unique_ptr<Chunk>> indexed;
+  uint64_t rowCount = 0;
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    const uint64_t begin = chunks[i].fileOffset;
+    const uint64_t end = i + 1 < chunks.size() ? chunks[i + 1].fileOffset : header.fileSize;
+    if (begin >= end || end > header.fileSize || chunks[i].rowCount == 0 || chunks[i].rowCount > end - begin)
+    {
+      return false;
+    }
+    auto chunk = std::make_unique<Chunk>();
+    chunk->fileOffset = static_cast<size_t>(begin);
+    chunk->rowCount = static_cast<size_t>(chunks[i].rowCount);
+    chunk->lines.resize(chunk->rowCount);
+    if (!in.Read(chunk->lines.data(), chunk->lines.size()))
+    {
+      return false;
+    }
+    for (auto line : chunk->lines)
+    {
+      if (line >= end - begin)
+      {
+        return false;
+      }
+    }
+    rowCount += chunk->rowCount;
+    plan.push_back({ static_cast<size_t>(begin), static_cast<size_t>(end) });
+    indexed.push_back(std::move(chunk));
+  }
+  if (rowCount != header.rowCount)
+  {
+    return false;
+  }
+  struct Dictionary
+  {
+    std::vector<IndexValue> values;
+    std::vector<uint32_t> codes;
+  };
+  std::vector<Dictionary> dictionaries(codedItems_.size());
+  for (size_t k = 0; k < dictionaries.size(); ++k)
+  {
+    IndexDictionary d;
+    if (!in.Read(&d) || d.item != static_cast<uint32_t>(codedItems_[k]) || d.codedRows > rowCount)
+    {
+      return false;
+    }
+    auto &dictionary = dictionaries[k];
+    dictionary.values.resize(d.valueCount);
+    dictionary.codes.resize(static_cast<size_t>(d.codedRows));
+    if (!in.Read(dictionary.values.data(), dictionary.values.size()) ||
+        !in.Read(dictionary.codes.data(), dictionary.codes.size()))
+    {
+      return false;
+    }
+    for (auto &&v : dictionary.values)
+    {
+      if (v.begin > v.end || v.end > header.fileSize)
+      {
+        return false;
+      }
+    }
+    for (auto code : dictionary.codes)
+    {
+      if (code >= d.valueCount)
+      {
+        return false;
+      }
+    }
+  }
+  if (!in.AtEnd())
+  {
+    return false;
+  }
+  // all rows are coded before the first chunk is published
+  std::vector<uint32_t> fileCodes;
+  std::wstring value;
+  for (size_t k = 0; k < dictionaries.size(); ++k)
+  {
+    auto &&values = dictionaries[k].values;
+    auto &&codes = dictionaries[k].codes;
+    fileCodes.resize(values.size());
+    bool full = false;
+    for (size_t v = 0; v < values.size() && !full; ++v)
+    {
+      value.clear();
+      DecodeUtf8(file_.Data() + values[v].begin, static_cast<size_t>(values[v].end - values[v].begin), &value);
+      bool added = false;
+      full = !dictionaries_[k]->Intern(value, &fileCodes[v], &added);
+      if (added)
+      {
+        valueRanges_[k].push_back({ static_cast<size_t>(values[v].begin), static_cast<size_t>(values[v].end) });
+      }
+    }
+    for (size_t r = 0; r < codes.size() && !full; ++r)
+    {
+      dictionaries_[k]->AppendCode(r, fileCodes[codes[r]]);
+    }
+  }
+  fields_ = fields;
+  minFields_ = header.minFields;
+  plan_ = std::move(plan);
+  indexed_ = std::move(indexed);
+  return true;
+}
+
+void TextLogStore::WriteIndex(size_t fileChunks) const
+{
+  int64_t writeTime = 0;
+  if (!LastWriteTime(path_, &writeTime))
+  {
+    return;
+  }
+  const auto path = IndexPath();
+  auto temporary = path;
+  temporary += L".tmp";
+  bool written = false;
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      return;
+    }
+    IndexHeader header = {0};
+    header.magic = indexMagic;
+    header.version = indexVersion;
+    header.fileSize = file_.Size();
+    header.writeTime = writeTime;
+    header.fieldCount = static_cast<uint32_t>(fields_.size());
+    header.minFields = static_cast<uint32_t>(minFields_);
+    header.codedCount = static_cast<uint32_t>(codedItems_.size());
+    header.chunkCount = static_cast<uint32_t>(fileChunks);
+    for (size_t i = 0; i < fileChunks; ++i)
+    {
+      header.rowCount += chunks_[i].load(std::memory_order_acquire)->rowCount;
+    }
+    Write(out, &header);
+    for (auto f : fields_)
+    {
+      const uint32_t item = static_cast<uint32_t>(f);
+      Write(out, &item);
+    }
+    for (size_t i = 0; i < fileChunks; ++i)
+    {
+      auto chunk = chunks_[i].load(std::memory_order_acquire);
+      const IndexChunk c = { chunk->fileOffset, chunk->rowCount };
+      Write(out, &c);
+    }
+    for (size_t i = 0; i < fileChunks; ++i)
+    {
+      auto chunk = chunks_[i].load(std::memory_order_acquire);
+      Write(out, chunk->lines.data(), chunk->lines.size());
+    }
+    std::vector<uint32_t> codes;
+    for (size_t k = 0; k < codedItems_.size() && !stopLoading_; ++k)
+    {
+      auto &dictionary = *dictionaries_[k];
+      const IndexDictionary d = { static_cast<uint32_t>(codedItems_[k]), static_cast<uint32_t>(valueRanges_[k].size()), dictionary.CodedRows() };
+      Write(out, &d);
+      for (auto &&r : valueRanges_[k])
+      {
+        const IndexValue v = { r.begin, r.end };
+        Write(out, &v);
+      }
+      for (size_t row = 0; row < d.codedRows; row += codes.size())
+      {
+        codes.resize(static_cast<size_t>(__min(d.codedRows - row, 0x10000)));
+        for (size_t r = 0; r < codes.size(); ++r)
+        {
+          dictionary.Code(row + r, &codes[r]);
+        }
+        Write(out, codes.data(), codes.size());
+      }
+    }
+    written = out.good() && !stopLoading_;
+  }
+  std::error_code ec;
+  if (written)
+  {
+    fs::rename(temporary, path, ec);
+  }
+  if (!written || ec)
+  {
+    fs::remove(temporary, ec);
+  }
+}
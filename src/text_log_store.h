@@ -0,0 +1,123 @@
+#pragma once
+
+#include "log_store.h"
+#include "mapped_file.h"
+#include "column_dictionary.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+// Text log, e.g. an earlier export, read straight from a memory mapped file.
+// The file is cut into chunks at line ends, the chunks are parsed on all
+// cores and published strictly in file order, so the first rows show up while
+// the rest is still being parsed. Lines in the exported layout, one tab
+// separated field per column, fill the columns, any other line goes to the
+// message column. Injected rows follow the rows of the file.
+// A lazy store only keeps where each line starts, a few bytes per row, and
+// the codes of the coded items. Other values are parsed when they are read
+// and kept in a RowCache of the reading thread. A lazy store writes what it
+// found to an index next to the file, reopening the unchanged file reads the
+// index instead of parsing the file again.
+class TextLogStore : public LogStore
+{
+public:
+  // Column header names and their items in export order.
+  using Columns = std::vector<std::pair<std::wstring, etl::TraceEventDataItem>>;
+  TextLogStore(const fs::path &path, const Columns &columns, bool lazy = false,
+               const std::vector<etl::TraceEventDataItem> &codedItems = {});
+  ~TextLogStore() override;
+  void SetCountCallback(const std::function<void(size_t)> &callback) override;
+  // Starts or resumes loading in the background.
+  bool Start() override;
+  // Stops loading, what has been published stays.
+  void Stop() override;
+  size_t GetItemCount() const override;
+  const std::wstring &GetItemValue(size_t row, etl::TraceEventDataItem item) const override;
+  const wchar_t *GetItemValue(size_t row, etl::TraceEventDataItem item, size_t *length) const override;
+  // Only injected rows have a time.
+  bool GetItemTime(size_t row, FILETIME *ft) const override;
+  // Lazy stores code the coded items of the file rows.
+  const ColumnDictionary *Dictionary(etl::TraceEventDataItem item) const override;
+  void ApplyFilters() override;
+  // The file is not read again afterwards.
+  void RemoveAllItems() override;
+  void InjectItem(const FILETIME &ft, const std::function<std::wstring(etl::TraceEventDataItem)> &values) override;
+private:
+  static const size_t ItemCount = static_cast<size_t>(etl::TraceEventDataItem::MAX_ITEM);
+  struct Range
+  {
+    size_t begin;
+    size_t end;
+  };
+  struct Chunk
+  {
+    size_t firstRow;
+    size_t rowCount;
+    // ItemCount cells per row, empty when lazy
+    std::vector<std::wstring> cells;
+    // injected rows
+    std::vector<FILETIME> times;
+    // lazy, start of the line of each row relative to fileOffset
+    size_t fileOffset;
+    std::vector<uint32_t> lines;
+    // lazy until published, the distinct values of each coded item in order
+    // of appearance and a code into them per row and coded item
+    std::vector<std::vector<std::string_view>> values;
+    std::vector<uint32_t> codes;
+  };
+  void Load();
+  void PlanChunks();
+  void ParseChunk(const Range &range, Chunk *chunk) const;
+  void SplitLine(const char *line, size_t length, std::string_view *fields) const;
+  void ParseLine(const char *line, size_t length, std::wstring *cells) const;
+  void Publish(std::unique_ptr<Chunk> chunk);
+  void CodeChunk(Chunk *chunk);
+  void AppendRow(const FILETIME &ft, std::wstring *cells);
+  const Chunk *FindChunk(size_t row) const;
+  const std::wstring &ParsedItem(const Chunk &chunk, size_t row, etl::TraceEventDataItem item) const;
+  fs::path IndexPath() const;
+  bool ReadIndex();
+  void WriteIndex(size_t fileChunks) const;
+private:
+  static const size_t MaxChunks = 0x10000;
+  static const size_t InjectChunkRows = 0x1000;
+  fs::path path_;
+  // item of each field position of a line
+  std::vector<etl::TraceEventDataItem> fields_;
+  // fewer fields make a line free text, the export trims empty trailing ones
+  size_t minFields_;
+  std::vector<std::wstring> headerNames_;
+  bool lazy_;
+  // tells the rows of this store apart in the per thread caches
+  uint64_t cacheOwner_;
+  std::vector<etl::TraceEventDataItem> codedItems_;
+  // index into codedItems_ by item, -1 if not coded
+  int codedSlot_[ItemCount];
+  std::vector<std::unique_ptr<ColumnDictionary>> dictionaries_;
+  // where in the file each dictionary value was first seen, for the index
+  std::vector<std::vector<Range>> valueRanges_;
+  std::function<void(size_t)> countCallback_;
+  MappedFile file_;
+  std::vector<Range> plan_;
+  // chunks of plan_ read from the index, empty when parsing
+  std::vector<std::unique_ptr<Chunk>> indexed_;
+  // next chunk of plan_ to publish
+  size_t nextChunk_;
+  std::unique_ptr<std::thread> loader_;
+  std::atomic<bool> stopLoading_;
+  // published chunks, firstRow ascending, never move while published
+  std::unique_ptr<std::atomic<Chunk *>[]> chunks_;
+  std::atomic<size_t> chunkCount_;
+  std::atomic<size_t> rowCount_;
+  // serializes publishing between the loader and injecting threads
+  std::mutex publishLock_;
+  // until the whole file is published
+  bool loading_;
+  // ItemCount cells per row injected while the file was still loading
+  std::vector<std::wstring> pendingCells_;
+  std::vector<FILETIME> pendingTimes_;
+  // chunk injected rows are added to until it is full
+  Chunk *injectChunk_;
+};
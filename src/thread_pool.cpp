@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+
+namespace
+{
+
+// index of the worker running on this thread, tasks submitted from within a
+// task end up in the submitting worker's own queue
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+} // private namespace
+
+struct ThreadPool::Worker
+{
+  std::mutex lock;
+  std::deque<std::function<void()>> tasks;
+  std::thread thread;
+};
+
+ThreadPool::ThreadPool(unsigned threadCount)
+  : pending_(0)
+  , nextQueue_(0)
+  , stop_(false)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::thread::hardware_concurrency();
+  }
+  if (threadCount == 0)
+  {
+    threadCount = 2;
+  }
+  for (unsigned i = 0; i < threadCount; ++i)
+  {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (unsigned i = 0; i < threadCount; ++i)
+  {
+    workers_[i]->thread = std::thread([this, i]() { Run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> l(wakeLock_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &w : workers_)
+  {
+    if (w->thread.joinable())
+    {
+      w->thread.join();
+    }
+  }
+}
+
+unsigned ThreadPool::ThreadCount() const
+{
+  return static_cast<unsigned>(workers_.size());
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+  const unsigned index = currentPool == this ? currentWorker : nextQueue_++ % ThreadCount();
+  {
+    std::lock_guard<std::mutex> l(workers_[index]->lock);
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> l(wakeLock_);
+    ++pending_;
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::TryPop(unsigned index, std::function<void()> &task)
+{
+  auto &w = *workers_[index];
+  std::lock_guard<std::mutex> l(w.lock);
+  if (w.tasks.empty())
+  {
+    return false;
+  }
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::TrySteal(unsigned index, std::function<void()> &task)
+{
+  for (unsigned i = 1; i < ThreadCount(); ++i)
+  {
+    auto &w = *workers_[(index + i) % ThreadCount()];
+    std::lock_guard<std::mutex> l(w.lock);
+    if (!w.tasks.empty())
+    {
+      task = std::move(w.tasks.front());
+      w.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(unsigned index)
+{
+  currentPool = this;
+  currentWorker = index;
+  for (;;)
+  {
+    std::function<void()> task;
+    if (TryPop(index, task) || TrySteal(index, task))
+    {
+      --pending_;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> l(wakeLock_);
+    wake_.wait(l, [this]() { return stop_ || pending_ > 0; });
+    if (stop_)
+    {
+      return;
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task queue. Workers run
+// their own queue newest first and steal the oldest tasks from the other
+// queues when they run dry, so one large batch of submitted chunks spreads
+// over all cores without a shared queue becoming the bottleneck.
+class ThreadPool
+{
+public:
+  // threadCount 0 means one worker per hardware thread
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  void Submit(std::function<void()> task);
+  unsigned ThreadCount() const;
+private:
+  struct Worker;
+  void Run(unsigned index);
+  bool TryPop(unsigned index, std::function<void()> &task);
+  bool TrySteal(unsigned index, std::function<void()> &task);
+private:
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::mutex wakeLock_;
+  std::condition_variable wake_;
+  std::atomic<size_t> pending_;
+  std::atomic<unsigned> nextQueue_;
+  bool stop_;
+};
@@ -0,0 +1,341 @@
+#include "trace_format.h"
+#include "cobs.h"
+#include "text_encoding.h"
+
+#include <cctype>
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+
+namespace
+{
+
+const size_t recordHeaderSize = 6;
+// output of a single conversion
+const size_t renderBufferSize = 128;
+
+std::wstring FromUtf8(const std::string &s)
+{
+  std::wstring out;
+  DecodeUtf8(s.c_str(), s.length(), &out);
+  return out;
+}
+
+uint64_t ReadLittleEndian(const uint8_t *p, size_t size)
+{
+  uint64_t v = 0;
+  for (size_t i = size; i > 0; --i)
+  {
+    v = v << 8 | p[i - 1];
+  }
+  return v;
+}
+
+} // private namespace
+
+TraceFormat::TraceFormat(const std::wstring &file, const std::wstring &function, const std::string &format)
+  : file_(file)
+  , function_(function)
+{
+  Parse(format);
+}
+
+const std::wstring &TraceFormat::File() const
+{
+  return file_;
+}
+
+const std::wstring &TraceFormat::Function() const
+{
+  return function_;
+}
+
+void TraceFormat::Parse(const std::string &format)
+{
+  std::string literal;
+  size_t i = 0;
+  while (i < format.length())
+  {
+    if (format[i] != '%')
+    {
+      literal += format[i++];
+      continue;
+    }
+    if (i + 1 < format.length() && format[i + 1] == '%')
+    {
+      literal += '%';
+      i += 2;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion
+    size_t p = i + 1;
+    std::wstring spec = L"%";
+    while (p < format.length() && strchr("-+ #0", format[p]) != nullptr && format[p] != 0)
+    {
+      spec += format[p++];
+    }
+    while (p < format.length() && (isdigit(static_cast<unsigned char>(format[p])) || format[p] == '.'))
+    {
+      spec += format[p++];
+    }
+    std::string length;
+    while (p < format.length() && strchr("hljztL", format[p]) != nullptr && format[p] != 0)
+    {
+      length += format[p++];
+    }
+    if (p == format.length())
+    {
+      literal += format.substr(i);
+      break;
+    }
+    Piece piece = { FromUtf8(literal), ArgType::None, 0, L"" };
+    const char conv = format[p];
+    const bool wide = length == "ll" || length == "j";
+    switch (conv)
+    {
+    case 'd':
+    case 'i':
+      piece.type = ArgType::Signed;
+      piece.size = wide ? 8 : length == "hh" ? 1 : length == "h" ? 2 : 4;
+      piece.spec = spec + L"ll" + static_cast<wchar_t>(conv);
+      break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      piece.type = ArgType::Unsigned;
+      piece.size = wide ? 8 : length == "hh" ? 1 : length == "h" ? 2 : 4;
+      piece.spec = spec + L"ll" + static_cast<wchar_t>(conv);
+      break;
+    case 'p':
+      piece.type = ArgType::Unsigned;
+      piece.size = 4;
+      piece.spec = L"0x%08llx";
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      piece.type = ArgType::Float;
+      piece.size = length == "l" || length == "L" ? 8 : 4;
+      piece.spec = spec + static_cast<wchar_t>(conv);
+      break;
+    case 'c':
+      piece.type = ArgType::Char;
+      piece.size = 1;
+      piece.spec = spec + L"lc";
+      break;
+    case 's':
+      piece.type = ArgType::String;
+      piece.size = 1;
+      piece.spec = spec + L"ls";
+      break;
+    default:
+      // not a conversion we know, shown as it is
+      literal += format.substr(i, p + 1 - i);
+      i = p + 1;
+      continue;
+    }
+    pieces_.push_back(piece);
+    literal.clear();
+    i = p + 1;
+  }
+  if (!literal.empty())
+  {
+    pieces_.push_back({ FromUtf8(literal), ArgType::None, 0, L"" });
+  }
+}
+
+bool TraceFormat::Render(const uint8_t *args, size_t length, std::wstring *text) const
+{
+  text->clear();
+  size_t pos = 0;
+  wchar_t buffer[renderBufferSize];
+  std::wstring str;
+  for (auto &&piece : pieces_)
+  {
+    text->append(piece.literal);
+    if (piece.type == ArgType::None)
+    {
+      continue;
+    }
+    if (length - pos < piece.size)
+    {
+      return false;
+    }
+    const uint64_t v = ReadLittleEndian(args + pos, piece.size);
+    pos += piece.size;
+    int n = -1;
+    switch (piece.type)
+    {
+    case ArgType::Signed:
+    {
+      // sign extend
+      const unsigned shift = static_cast<unsigned>(64 - piece.size * 8);
+      n = swprintf(buffer, renderBufferSize, piece.spec.c_str(), static_cast<long long>(v << shift) >> shift);
+      break;
+    }
+    case ArgType::Unsigned:
+      n = swprintf(buffer, renderBufferSize, piece.spec.c_str(), static_cast<unsigned long long>(v));
+      break;
+    case ArgType::Float:
+    {
+      double d = 0;
+      if (piece.size == 4)
+      {
+        float f;
+        const uint32_t bits = static_cast<uint32_t>(v);
+        memcpy(&f, &bits, sizeof(f));
+        d = f;
+      }
+      else
+      {
+        memcpy(&d, &v, sizeof(d));
+      }
+      n = swprintf(buffer, renderBufferSize, piece.spec.c_str(), d);
+      break;
+    }
+    case ArgType::Char:
+      n = swprintf(buffer, renderBufferSize, piece.spec.c_str(), static_cast<wint_t>(v));
+      break;
+    case ArgType::String:
+      if (length - pos < v)
+      {
+        return false;
+      }
+      str.clear();
+      DecodeUtf8(reinterpret_cast<const char *>(args + pos), static_cast<size_t>(v), &str);
+      pos += static_cast<size_t>(v);
+      n = swprintf(buffer, renderBufferSize, piece.spec.c_str(), str.c_str());
+      if (n < 0)
+      {
+        // longer than the buffer, the conversion's width and precision are
+        // of no use for such a string anyway
+        text->append(str);
+        continue;
+      }
+      break;
+    default:
+      break;
+    }
+    text->append(buffer, n < 0 ? 0 : n);
+  }
+  return pos == length;
+}
+
+bool TraceFormatTable::Load(const std::filesystem::path &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    return false;
+  }
+  formats_.clear();
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+    // the format is last, it may hold tabs itself
+    const auto t1 = line.find('\t');
+    const auto t2 = t1 == std::string::npos ? t1 : line.find('\t', t1 + 1);
+    const auto t3 = t2 == std::string::npos ? t2 : line.find('\t', t2 + 1);
+    if (t3 == std::string::npos)
+    {
+      continue;
+    }
+    char *end = nullptr;
+    const auto id = strtoul(line.c_str(), &end, 0);
+    if (end != line.c_str() + t1)
+    {
+      continue;
+    }
+    formats_.insert_or_assign(static_cast<uint32_t>(id), TraceFormat(
+      FromUtf8(line.substr(t1 + 1, t2 - t1 - 1)),
+      FromUtf8(line.substr(t2 + 1, t3 - t2 - 1)),
+      line.substr(t3 + 1)));
+  }
+  return true;
+}
+
+bool TraceFormatTable::IsEmpty() const
+{
+  return formats_.empty();
+}
+
+const TraceFormat *TraceFormatTable::Find(uint32_t id) const
+{
+  auto it = formats_.find(id);
+  return it != formats_.end() ? &it->second : nullptr;
+}
+
+BinaryTraceDecoder::BinaryTraceDecoder(const TraceFormatTable &formats)
+  : formats_(formats)
+  , format_(nullptr)
+  , started_(false)
+  , lastStamp_(0)
+  , time_(0)
+{
+}
+
+bool BinaryTraceDecoder::Decode(const char *frame, size_t length)
+{
+  data_.resize(length);
+  size_t size = 0;
+  if (!CobsDecode(reinterpret_cast<const uint8_t *>(frame), length, data_.data(), &size) || size < recordHeaderSize)
+  {
+    return false;
+  }
+  const auto id = static_cast<uint32_t>(ReadLittleEndian(data_.data(), 2));
+  const auto stamp = static_cast<uint32_t>(ReadLittleEndian(data_.data() + 2, 4));
+  if (started_)
+  {
+    // unsigned difference steps over a wrapped counter
+    time_ += static_cast<uint32_t>(stamp - lastStamp_);
+  }
+  started_ = true;
+  lastStamp_ = stamp;
+  const auto args = data_.data() + recordHeaderSize;
+  const auto argsLength = size - recordHeaderSize;
+  format_ = formats_.Find(id);
+  if (!format_)
+  {
+    text_ = L"unknown format " + std::to_wstring(id) + L", " + std::to_wstring(argsLength) + L" argument bytes";
+  }
+  else if (!format_->Render(args, argsLength, &text_))
+  {
+    text_ += L" [arguments do not match the format]";
+  }
+  return true;
+}
+
+uint64_t BinaryTraceDecoder::Time() const
+{
+  return time_;
+}
+
+const TraceFormat *BinaryTraceDecoder::Format() const
+{
+  return format_;
+}
+
+const std::wstring &BinaryTraceDecoder::Text() const
+{
+  return text_;
+}
+
+void BinaryTraceDecoder::Reset()
+{
+  started_ = false;
+  time_ = 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// printf style format of one trace statement in the device firmware. The
+// device sends only the id of the format and the raw argument bytes, the
+// text is put together here. Arguments are little endian and packed:
+// hh 1 byte, h 2 bytes, no length, l, z and p 4 bytes, ll and j 8 bytes,
+// f/e/g a 4 byte float or with l/L an 8 byte double, c 1 byte and s a
+// length byte followed by that many UTF-8 bytes.
+class TraceFormat
+{
+public:
+  TraceFormat(const std::wstring &file, const std::wstring &function, const std::string &format);
+  const std::wstring &File() const;
+  const std::wstring &Function() const;
+  // Replaces *text, false if the arguments do not fit the format.
+  bool Render(const uint8_t *args, size_t length, std::wstring *text) const;
+private:
+  enum class ArgType
+  {
+    None,
+    Signed,
+    Unsigned,
+    Float,
+    Char,
+    String
+  };
+  struct Piece
+  {
+    std::wstring literal;
+    ArgType type;
+    size_t size;
+    // conversion for swprintf, e.g. %08llx
+    std::wstring spec;
+  };
+  void Parse(const std::string &format);
+private:
+  std::wstring file_;
+  std::wstring function_;
+  std::vector<Piece> pieces_;
+};
+
+// Formats by id, loaded from the table the firmware build writes: one
+// format per line, id<TAB>file<TAB>function<TAB>format, UTF-8, lines
+// starting with # are comments.
+class TraceFormatTable
+{
+public:
+  bool Load(const std::filesystem::path &path);
+  bool IsEmpty() const;
+  const TraceFormat *Find(uint32_t id) const;
+private:
+  std::unordered_map<uint32_t, TraceFormat> formats_;
+};
+
+// Turns the COBS framed records of the binary serial protocol into columns.
+// A decoded record is a 2 byte format id, a 4 byte device time stamp in
+// microseconds and the arguments.
+class BinaryTraceDecoder
+{
+public:
+  explicit BinaryTraceDecoder(const TraceFormatTable &formats);
+  // Decodes one frame, false if it is broken. The accessors describe the
+  // last decoded record.
+  bool Decode(const char *frame, size_t length);
+  // Microseconds since the first record, the device counter may wrap.
+  uint64_t Time() const;
+  // Null for an unknown id, Text says so then.
+  const TraceFormat *Format() const;
+  const std::wstring &Text() const;
+  // The next record starts the time line anew, e.g. after reconnecting.
+  void Reset();
+private:
+  const TraceFormatTable &formats_;
+  std::vector<uint8_t> data_;
+  const TraceFormat *format_;
+  std::wstring text_;
+  bool started_;
+  uint32_t lastStamp_;
+  uint64_t time_;
+};
@@ -0,0 +1,38 @@
+#include "update_coalescer.h"
+
+UpdateCoalescer::UpdateCoalescer()
+  : rowCount_(0)
+  , layoutChanged_(false)
+  , publishedRows_(0)
+{
+}
+
+void UpdateCoalescer::RowsAdded(size_t rowCount)
+{
+  rowCount_.store(rowCount, std::memory_order_release);
+}
+
+void UpdateCoalescer::LayoutChanged()
+{
+  layoutChanged_.store(true, std::memory_order_release);
+}
+
+bool UpdateCoalescer::Take(Update *update)
+{
+  const auto rowCount = rowCount_.load(std::memory_order_acquire);
+  if (rowCount == publishedRows_ && !layoutChanged_.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  update->rowCount = rowCount;
+  update->layoutChanged = layoutChanged_.exchange(false, std::memory_order_acq_rel);
+  publishedRows_ = rowCount;
+  return true;
+}
+
+void UpdateCoalescer::Reset()
+{
+  rowCount_ = 0;
+  layoutChanged_ = false;
+  publishedRows_ = 0;
+}
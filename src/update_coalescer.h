@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Gathers what ingestion changed so the view can pick it up in one go at a
+// fixed rate instead of once per event. Recording is a couple of atomic
+// stores and may happen on any thread; Take belongs to the UI thread, which
+// calls it from its refresh timer, so there is at most one update per tick
+// however many events came in.
+class UpdateCoalescer
+{
+public:
+  struct Update
+  {
+    size_t rowCount;
+    // column widths need another look
+    bool layoutChanged;
+  };
+  UpdateCoalescer();
+  void RowsAdded(size_t rowCount);
+  void LayoutChanged();
+  // False if nothing changed since the last update.
+  bool Take(Update *update);
+  // Forgets everything recorded, rows were removed.
+  void Reset();
+private:
+  std::atomic<size_t> rowCount_;
+  std::atomic<bool> layoutChanged_;
+  size_t publishedRows_;
+};
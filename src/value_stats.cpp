@@ -0,0 +1,118 @@
+#include "value_stats.h"
+
+#include <algorithm>
+
+ValueStats::ValueStats(size_t exactLimit, size_t topK)
+  : exactLimit_(exactLimit)
+  , topK_(topK)
+{
+}
+
+void ValueStats::Add(const std::wstring &value)
+{
+  std::lock_guard<std::mutex> l(lock_);
+  if (heap_.empty())
+  {
+    ++exact_[value];
+    if (exact_.size() > exactLimit_)
+    {
+      SwitchToSketch();
+    }
+    return;
+  }
+  auto it = slots_.find(value);
+  if (it != slots_.end())
+  {
+    ++heap_[it->second].count;
+    SiftDown(it->second);
+    return;
+  }
+  auto &least = heap_.front();
+  slots_.erase(least.value);
+  least.error = least.count;
+  ++least.count;
+  least.value = value;
+  slots_[value] = 0;
+  SiftDown(0);
+}
+
+void ValueStats::SwitchToSketch()
+{
+  std::vector<Entry> entries;
+  entries.reserve(exact_.size());
+  for (auto &&e : exact_)
+  {
+    entries.push_back(Entry{e.first, e.second, 0});
+  }
+  exact_.clear();
+  const auto keep = std::min(topK_, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + keep, entries.end(), [](const Entry &a, const Entry &b) { return a.count > b.count; });
+  entries.resize(keep);
+  // descending counts read backwards are a valid min-heap
+  heap_.assign(entries.rbegin(), entries.rend());
+  slots_.clear();
+  for (size_t i = 0; i < heap_.size(); ++i)
+  {
+    slots_[heap_[i].value] = i;
+  }
+}
+
+void ValueStats::SiftDown(size_t i)
+{
+  for (;;)
+  {
+    size_t smallest = i;
+    for (auto child : {2 * i + 1, 2 * i + 2})
+    {
+      if (child < heap_.size() && heap_[child].count < heap_[smallest].count)
+      {
+        smallest = child;
+      }
+    }
+    if (smallest == i)
+    {
+      return;
+    }
+    std::swap(heap_[i], heap_[smallest]);
+    slots_[heap_[i].value] = i;
+    slots_[heap_[smallest].value] = smallest;
+    i = smallest;
+  }
+}
+
+void ValueStats::Clear()
+{
+  std::lock_guard<std::mutex> l(lock_);
+  exact_.clear();
+  heap_.clear();
+  slots_.clear();
+}
+
+bool ValueStats::IsExact() const
+{
+  std::lock_guard<std::mutex> l(lock_);
+  return heap_.empty();
+}
+
+std::vector<ValueStats::Entry> ValueStats::Top(size_t k) const
+{
+  std::vector<Entry> entries;
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    if (heap_.empty())
+    {
+      for (auto &&e : exact_)
+      {
+        entries.push_back(Entry{e.first, e.second, 0});
+      }
+    }
+    else
+    {
+      entries = heap_;
+    }
+  }
+  k = std::min(k, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + k, entries.end(), [](const Entry &a, const Entry &b) { return a.count > b.count; });
+  entries.resize(k);
+  return entries;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counts how often the values of a column occur within bounded memory.
+// Counts are exact until more than exactLimit distinct values have been
+// seen, from then on only the topK most frequent ones are tracked with the
+// Space-Saving algorithm: a value not tracked replaces the least frequent
+// one and inherits its count, which is kept as the possible overestimate.
+class ValueStats
+{
+public:
+  struct Entry
+  {
+    std::wstring value;
+    size_t count;
+    // count may be too high by up to this much
+    size_t error;
+  };
+  explicit ValueStats(size_t exactLimit = 0x1000, size_t topK = 0x100);
+  void Add(const std::wstring &value);
+  void Clear();
+  bool IsExact() const;
+  // Most frequent values first.
+  std::vector<Entry> Top(size_t k) const;
+private:
+  void SwitchToSketch();
+  void SiftDown(size_t i);
+private:
+  const size_t exactLimit_;
+  const size_t topK_;
+  mutable std::mutex lock_;
+  std::unordered_map<std::wstring, size_t> exact_;
+  // min-heap on count and the heap slot of every tracked value
+  std::vector<Entry> heap_;
+  std::unordered_map<std::wstring, size_t> slots_;
+};
@@ -0,0 +1,137 @@
+#include "debouncer.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Drives Debouncer through a hand-moved clock, the way the filter box does
+// with a burst of keystrokes.
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  class FakeClock
+  {
+  public:
+    Debouncer::TimeSource Source()
+    {
+      return [this]() { return now_; };
+    }
+    void Advance(Debouncer::Clock::duration step)
+    {
+      now_ += step;
+    }
+  private:
+    Debouncer::Clock::time_point now_;
+  };
+
+  void IdleNeverFires()
+  {
+    FakeClock clock;
+    Debouncer debouncer(300ms, clock.Source());
+    Check(!debouncer.IsPending(), "idle not pending");
+    Check(debouncer.Remaining() == 0ms, "idle has no time left");
+    clock.Advance(1s);
+    Check(!debouncer.Fire(), "idle does not fire");
+  }
+
+  // keystrokes closer than the delay push the deadline out, the burst fires
+  // once, the delay after its last keystroke
+  void BurstFiresOnce()
+  {
+    FakeClock clock;
+    Debouncer debouncer(300ms, clock.Source());
+    for (int key = 0; key < 20; ++key)
+    {
+      debouncer.Request();
+      Check(debouncer.Remaining() == 300ms, "full delay after a keystroke");
+      clock.Advance(120ms);
+      Check(!debouncer.Fire(), "no fire within the burst");
+      Check(debouncer.Remaining() == 180ms, "delay counts from the last keystroke");
+    }
+    clock.Advance(179ms);
+    Check(!debouncer.Fire(), "no fire just before the delay");
+    Check(debouncer.Remaining() == 1ms, "one ms left");
+    clock.Advance(1ms);
+    Check(debouncer.Remaining() == 0ms, "due");
+    Check(debouncer.Fire(), "fires at the delay");
+    Check(!debouncer.IsPending(), "not pending after firing");
+    Check(!debouncer.Fire(), "fires once per burst");
+    clock.Advance(1s);
+    Check(!debouncer.Fire(), "still fired once");
+  }
+
+  // a late poll fires once, however late it comes
+  void LatePoll()
+  {
+    FakeClock clock;
+    Debouncer debouncer(300ms, clock.Source());
+    debouncer.Request();
+    clock.Advance(5s);
+    Check(debouncer.Remaining() == 0ms, "overdue has no time left");
+    Check(debouncer.Fire(), "late poll fires");
+    Check(!debouncer.Fire(), "late poll fires once");
+  }
+
+  // applying the filters directly drops the pending burst, the next one
+  // starts over
+  void CancelDropsBurst()
+  {
+    FakeClock clock;
+    Debouncer debouncer(300ms, clock.Source());
+    debouncer.Request();
+    clock.Advance(200ms);
+    debouncer.Cancel();
+    Check(!debouncer.IsPending(), "cancelled not pending");
+    Check(debouncer.Remaining() == 0ms, "cancelled has no time left");
+    clock.Advance(200ms);
+    Check(!debouncer.Fire(), "cancelled does not fire");
+    debouncer.Request();
+    clock.Advance(299ms);
+    Check(!debouncer.Fire(), "new burst waits the full delay");
+    clock.Advance(1ms);
+    Check(debouncer.Fire(), "new burst fires");
+  }
+
+  // bursts separated by more than the delay fire each
+  void SeparateBursts()
+  {
+    FakeClock clock;
+    Debouncer debouncer(300ms, clock.Source());
+    int fired = 0;
+    for (int burst = 0; burst < 5; ++burst)
+    {
+      for (int key = 0; key < 3; ++key)
+      {
+        debouncer.Request();
+        clock.Advance(50ms);
+        fired += debouncer.Fire();
+      }
+      for (int tick = 0; tick < 10; ++tick)
+      {
+        clock.Advance(50ms);
+        fired += debouncer.Fire();
+      }
+    }
+    Check(fired == 5, "one fire per burst");
+  }
+} // private namespace
+
+int main()
+{
+  IdleNeverFires();
+  BurstFiresOnce();
+  LatePoll();
+  CancelDropsBurst();
+  SeparateBursts();
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include "line_framer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Replays a canned serial capture through LineFramer with every read size
+// from one byte up, so CR/LF pairs and lines are split at every possible
+// position, and compares the lines with a plain split of the whole capture.
+// Usage: line_framer_test capture
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  std::string ReadCapture(const char *path)
+  {
+    std::ifstream in(path, std::ios::binary);
+    Check(in.good(), "capture opened");
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  // complete lines without trailing white space, empty ones left out
+  std::vector<std::string> SplitLines(const std::string &data)
+  {
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    for (size_t nl; (nl = data.find('\n', begin)) != std::string::npos; begin = nl + 1)
+    {
+      std::string line = data.substr(begin, nl - begin);
+      line.erase(line.find_last_not_of(" \t\r\n\v\f") + 1);
+      if (!line.empty())
+      {
+        lines.push_back(line);
+      }
+    }
+    return lines;
+  }
+
+  std::vector<std::string> Replay(const std::string &data, size_t readSize, size_t maxLineLength = 0x10000)
+  {
+    LineFramer framer(readSize, maxLineLength);
+    std::vector<std::string> lines;
+    const auto onLine = [&lines](const char *line, size_t length)
+    {
+      lines.emplace_back(line, length);
+    };
+    for (size_t pos = 0; pos < data.size();)
+    {
+      const size_t bytes = std::min(framer.ReadSize(), data.size() - pos);
+      std::copy_n(data.data() + pos, bytes, framer.ReadBuffer());
+      framer.Consume(bytes, onLine);
+      pos += bytes;
+    }
+    return lines;
+  }
+
+  void EveryReadSize(const std::string &capture)
+  {
+    const auto expected = SplitLines(capture);
+    Check(expected.size() > 400, "capture has lines");
+    for (size_t readSize = 1; readSize <= 300; ++readSize)
+    {
+      Check(Replay(capture, readSize) == expected, "lines with small reads");
+    }
+    for (size_t readSize : { 2000, 0x800, 0x10000 })
+    {
+      Check(Replay(capture, readSize) == expected, "lines with large reads");
+    }
+  }
+
+  // a line past maxLineLength comes in pieces that add up to the line
+  void LongLineInPieces(const std::string &capture)
+  {
+    const auto expected = SplitLines(capture);
+    const auto dump = std::find_if(expected.begin(), expected.end(), [](const std::string &line)
+    {
+      return line.compare(0, 5, "dump:") == 0;
+    });
+    Check(dump != expected.end() && dump->length() > 0x1000, "capture has a long line");
+    for (size_t readSize : { 7, 100, 0x800 })
+    {
+      const auto lines = Replay(capture, readSize, 0x400);
+      Check(lines.size() > expected.size(), "long line split");
+      auto piece = std::find_if(lines.begin(), lines.end(), [](const std::string &line)
+      {
+        return line.compare(0, 5, "dump:") == 0;
+      });
+      std::string joined;
+      // the line after the dump is the next sample
+      for (; piece != lines.end() && (joined.empty() || (*piece)[0] != '['); ++piece)
+      {
+        Check(piece->length() <= 0x400 + readSize, "piece length");
+        joined += *piece;
+      }
+      // only white space at the edges of the pieces may be lost
+      joined.erase(std::remove(joined.begin(), joined.end(), ' '), joined.end());
+      std::string whole = *dump;
+      whole.erase(std::remove(whole.begin(), whole.end(), ' '), whole.end());
+      Check(joined == whole, "pieces add up to the line");
+    }
+  }
+
+  void ClearDropsPartialLine()
+  {
+    LineFramer framer(16);
+    std::vector<std::string> lines;
+    const auto onLine = [&lines](const char *line, size_t length)
+    {
+      lines.emplace_back(line, length);
+    };
+    const auto feed = [&framer, &onLine](const char *text)
+    {
+      const size_t length = strlen(text);
+      std::copy_n(text, length, framer.ReadBuffer());
+      framer.Consume(length, onLine);
+    };
+    feed("before\r\nhalf a l");
+    framer.Clear();
+    feed("after\r\n");
+    Check(lines == std::vector<std::string>({ "before", "after" }), "partial line dropped");
+  }
+
+  // records of the binary protocol end in a zero byte and keep white space
+  void ZeroDelimiter()
+  {
+    LineFramer framer(4, 0x100, '\0');
+    std::vector<std::string> records;
+    const std::string data("ab \r\0\0c\nd\0", 10);
+    for (char c : data)
+    {
+      *framer.ReadBuffer() = c;
+      framer.Consume(1, [&records](const char *record, size_t length)
+      {
+        records.emplace_back(record, length);
+      });
+    }
+    Check(records == std::vector<std::string>({ "ab \r", "c\nd" }), "zero delimited records");
+  }
+} // private namespace
+
+int main(int argc, char **argv)
+{
+  Check(argc > 1, "capture given");
+  const std::string capture = ReadCapture(argv[1]);
+  EveryReadSize(capture);
+  LongLineInPieces(capture);
+  ClearDropsPartialLine();
+  ZeroDelimiter();
+  return 0;
+}
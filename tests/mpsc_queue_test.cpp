@@ -0,0 +1,105 @@
+#include "mpsc_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  struct Item
+  {
+    size_t producer;
+    size_t sequence;
+  };
+
+  // Producers push as fast as they can while the consumer alternates
+  // between draining and sleeping in Wait, every item has to arrive exactly
+  // once and in push order per producer.
+  void ManyProducers(size_t producerCount, size_t itemsPerProducer)
+  {
+    MpscQueue<std::unique_ptr<Item>> queue;
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < producerCount; ++p)
+    {
+      producers.emplace_back([&queue, p, itemsPerProducer]()
+      {
+        for (size_t i = 0; i < itemsPerProducer; ++i)
+        {
+          queue.Push(std::unique_ptr<Item>(new Item{p, i}));
+          // now and then let the consumer run dry and go to sleep
+          if (i % 10000 == 0)
+          {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+          }
+        }
+      });
+    }
+    std::vector<size_t> next(producerCount, 0);
+    const size_t total = producerCount * itemsPerProducer;
+    size_t received = 0;
+    std::unique_ptr<Item> item;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (received < total)
+    {
+      Check(std::chrono::steady_clock::now() < deadline, "all items arrive");
+      if (!queue.Pop(&item))
+      {
+        queue.Wait(std::chrono::milliseconds(100));
+        continue;
+      }
+      Check(item->producer < producerCount, "item from a known producer");
+      Check(item->sequence == next[item->producer], "items in push order per producer");
+      ++next[item->producer];
+      ++received;
+    }
+    for (auto &producer : producers)
+    {
+      producer.join();
+    }
+    Check(!queue.Pop(&item), "no extra items");
+    printf("%zu producers, %zu items\n", producerCount, received);
+  }
+
+  // Wait has to return promptly on a push, not only after its timeout.
+  void WaitWakesOnPush()
+  {
+    MpscQueue<int> queue;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread producer([&queue]()
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      queue.Push(1);
+    });
+    int value = 0;
+    while (!queue.Pop(&value))
+    {
+      queue.Wait(std::chrono::seconds(10));
+    }
+    producer.join();
+    Check(value == 1, "pushed value");
+    Check(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), "woken by the push");
+  }
+} // private namespace
+
+int main()
+{
+  const size_t cores = std::max(2u, std::thread::hardware_concurrency());
+  ManyProducers(1, 200000);
+  ManyProducers(cores, 200000);
+  ManyProducers(cores * 4, 50000);
+  WaitWakesOnPush();
+  return 0;
+}
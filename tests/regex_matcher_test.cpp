@@ -0,0 +1,163 @@
+#include "regex_matcher.h"
+#include "regex_syntax.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace
+{
+  void Check(bool ok, const char *what, const std::wstring &pattern = L"", const std::wstring &text = L"")
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s, pattern '%ls' text '%ls'\n", what, pattern.c_str(), text.c_str());
+      exit(1);
+    }
+  }
+
+  bool Expected(const std::wstring &pattern, const std::wstring &text)
+  {
+    const std::wregex regex(pattern, std::regex_constants::icase);
+    return std::regex_search(text, regex);
+  }
+
+  void CheckAgainstStd(const std::wstring &pattern, const std::vector<std::wstring> &texts)
+  {
+    auto matcher = CompileRegexMatcher(pattern);
+    for (auto &&text : texts)
+    {
+      const bool found = matcher->Search(text.data(), text.data() + text.size());
+      Check(found == Expected(pattern, text), "same result as std::wregex", pattern, text);
+    }
+  }
+
+  const std::vector<std::wstring> &Subjects()
+  {
+    static const std::vector<std::wstring> subjects = {
+      L"", L"a", L"A", L"ab", L"AB", L"abc", L"xAbCx", L"aaa", L"baaab", L"123", L"a1b2",
+      L"Error: disk full", L"error 42 in module.dll", L"WARN timeout after 1500 ms",
+      L"line\nbreak", L"tab\there", L"foo_bar-baz", L"  spaced  ", L"[brackets]", L"a.b", L"a+b",
+    };
+    return subjects;
+  }
+
+  // Constructs of the subset, each of them has to take the linear path.
+  void SupportedSubset()
+  {
+    const wchar_t *patterns[] = {
+      L"a", L"ab", L"error", L"ERROR", L"a|b", L"ab|cd|e", L"a*", L"a+b", L"ba?b", L"a{2}", L"a{1,2}b", L"a{2,}",
+      L"(ab)+", L"(a|b)*c", L"a*?", L"a+?b", L".", L"a.b", L"^a", L"b$", L"^$", L"^abc$", L"[abc]", L"[a-c]+",
+      L"[^a]", L"[^a-z]", L"\\d+", L"\\D", L"\\w+", L"\\W", L"\\s", L"\\S+", L"\\.", L"\\+", L"\\[", L"\\t",
+      L"\\x41", L"\\u0062", L"error \\d+", L"(warn|error).*\\d+ ms", L"[.]", L"[\\d_]+", L"a(|b)c", L"()",
+    };
+    for (auto pattern : patterns)
+    {
+      Check(ParseRegex(pattern) != nullptr, "pattern is in the subset", pattern);
+      Check(CompileRegexMatcher(pattern)->IsLinear(), "subset takes the linear path", pattern);
+      CheckAgainstStd(pattern, Subjects());
+    }
+  }
+
+  // Anything else still works through std::wregex.
+  void Fallback()
+  {
+    const wchar_t *patterns[] = {
+      L"(a)\\1", L"\\bab", L"a\\B", L"a(?=b)", L"a(?!b)", L"[[:digit:]]+", L"(\\w)\\1",
+    };
+    for (auto pattern : patterns)
+    {
+      Check(ParseRegex(pattern) == nullptr, "pattern is outside the subset", pattern);
+      Check(!CompileRegexMatcher(pattern)->IsLinear(), "fallback to std::wregex", pattern);
+      CheckAgainstStd(pattern, Subjects());
+    }
+    bool thrown = false;
+    try
+    {
+      CompileRegexMatcher(L"(a");
+    }
+    catch (const std::regex_error &)
+    {
+      thrown = true;
+    }
+    Check(thrown, "malformed pattern throws like std::regex", L"(a");
+  }
+
+  void Literals()
+  {
+    std::wstring literal;
+    Check(ExactLiteral(*ParseRegex(L"Error"), &literal) && literal == L"error", "exact literal is folded", L"Error");
+    Check(!ExactLiteral(*ParseRegex(L"err?or"), &literal), "optional part is no exact literal", L"err?or");
+    Check(RequiredLiteral(*ParseRegex(L"\\d+ TIMEOUT \\w+")) == L" timeout ", "required literal", L"\\d+ TIMEOUT \\w+");
+    Check(RequiredLiteral(*ParseRegex(L"a|b")).empty(), "no required literal across alternatives", L"a|b");
+  }
+
+  // Random patterns of the subset against random texts, compared with
+  // std::wregex.
+  std::wstring RandomPattern(std::mt19937 &rng, int depth)
+  {
+    static const wchar_t *atoms[] = {
+      L"a", L"b", L"A", L"B", L"1", L" ", L".", L"\\d", L"\\w", L"\\s", L"\\W", L"[ab]", L"[^a]", L"[a-b1]", L"\\.",
+    };
+    static const wchar_t *quantifiers[] = { L"", L"", L"", L"*", L"+", L"?", L"{1,2}", L"{2}", L"*?", L"+?" };
+    std::wstring pattern;
+    const int terms = 1 + rng() % 3;
+    for (int t = 0; t < terms; ++t)
+    {
+      if (depth < 2 && rng() % 5 == 0)
+      {
+        // std::regex backtracks exponentially on repeated groups of
+        // repetitions, groups are at most optional
+        pattern += L"(" + RandomPattern(rng, depth + 1) + L"|" + RandomPattern(rng, depth + 1) + L")";
+        pattern += rng() % 3 == 0 ? L"?" : L"";
+      }
+      else
+      {
+        pattern += atoms[rng() % (sizeof(atoms) / sizeof(atoms[0]))];
+        pattern += quantifiers[rng() % (sizeof(quantifiers) / sizeof(quantifiers[0]))];
+      }
+    }
+    if (depth == 0 && rng() % 8 == 0)
+    {
+      pattern = L"^" + pattern;
+    }
+    if (depth == 0 && rng() % 8 == 0)
+    {
+      pattern += L"$";
+    }
+    return pattern;
+  }
+
+  void Random()
+  {
+    std::mt19937 rng(2024);
+    const wchar_t alphabet[] = L"aAbB1 ._-\n";
+    std::vector<std::wstring> texts(32);
+    for (int round = 0; round < 2000; ++round)
+    {
+      for (auto &text : texts)
+      {
+        text.resize(rng() % 12);
+        for (auto &c : text)
+        {
+          c = alphabet[rng() % (sizeof(alphabet) / sizeof(alphabet[0]) - 1)];
+        }
+      }
+      const auto pattern = RandomPattern(rng, 0);
+      Check(ParseRegex(pattern) != nullptr, "random pattern is in the subset", pattern);
+      CheckAgainstStd(pattern, texts);
+    }
+  }
+} // private namespace
+
+int main()
+{
+  SupportedSubset();
+  Fallback();
+  Literals();
+  Random();
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "serial_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  std::string TestLine(size_t n)
+  {
+    // lengths vary so that lines cross the reads, every third ends in CR LF
+    std::string line = "line " + std::to_string(n) + " ";
+    line.append(n % 97, static_cast<char>('a' + n % 26));
+    // the framer trims trailing white space
+    line += '.';
+    return line;
+  }
+
+  // Pushes lines into the master side of a pty while SerialReader reads the
+  // slave side through the POSIX transport at the given rate.
+  void Throughput(int baudRate, size_t lineCount)
+  {
+    int master = -1;
+    int slave = -1;
+    termios raw = {};
+    cfmakeraw(&raw);
+    char name[128] = {0};
+    Check(openpty(&master, &slave, name, &raw, nullptr) == 0, "openpty");
+    std::vector<std::string> received;
+    received.reserve(lineCount);
+    std::atomic<bool> running(true);
+    std::wstring error;
+    SerialReader reader(CreateSerialTransport(), std::wstring(name, name + strlen(name)), baudRate);
+    std::thread readerThread([&]()
+    {
+      reader.Run(running, [&](const std::vector<SerialReader::Line> &lines)
+      {
+        for (auto &&line : lines)
+        {
+          received.emplace_back(line.text, line.length);
+        }
+        if (received.size() >= lineCount)
+        {
+          running = false;
+        }
+      }, [&](const std::wstring &message)
+      {
+        error = message;
+      });
+    });
+    // give the reader time to open and configure the port
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto start = std::chrono::steady_clock::now();
+    std::string chunk;
+    size_t bytes = 0;
+    for (size_t n = 0; n < lineCount; ++n)
+    {
+      chunk += TestLine(n);
+      chunk += n % 3 == 0 ? "\r\n" : "\n";
+      if (chunk.size() >= 0x1000 || n + 1 == lineCount)
+      {
+        for (size_t written = 0; written < chunk.size();)
+        {
+          const ssize_t w = write(master, chunk.data() + written, chunk.size() - written);
+          Check(w > 0, "write to the pty");
+          written += static_cast<size_t>(w);
+        }
+        bytes += chunk.size();
+        chunk.clear();
+      }
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (running && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    readerThread.join();
+    close(slave);
+    close(master);
+    Check(error.empty(), "no read errors");
+    Check(received.size() == lineCount, "all lines arrive");
+    for (size_t n = 0; n < lineCount; ++n)
+    {
+      if (received[n] != TestLine(n))
+      {
+        fprintf(stderr, "line %zu: '%s'\n", n, received[n].c_str());
+        Check(false, "lines arrive intact and in order");
+      }
+    }
+    printf("%d baud: %zu lines, %zu bytes in %.1f ms, %.1f MB/s\n", baudRate, lineCount, bytes,
+      seconds * 1000, bytes / seconds / 1e6);
+  }
+} // private namespace
+
+int main()
+{
+  Throughput(921600, 100000);
+  Throughput(3000000, 200000);
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include "cobs.h"
+#include "trace_format.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  // the firmware's side of the framing, without the trailing zero
+  std::vector<uint8_t> CobsEncode(const std::vector<uint8_t> &data)
+  {
+    std::vector<uint8_t> out(1);
+    size_t code = 0;
+    uint8_t n = 1;
+    for (uint8_t b : data)
+    {
+      if (b != 0)
+      {
+        out.push_back(b);
+        ++n;
+      }
+      if (b == 0 || n == 0xFF)
+      {
+        out[code] = n;
+        code = out.size();
+        out.push_back(0);
+        n = 1;
+      }
+    }
+    out[code] = n;
+    return out;
+  }
+
+  bool Decodes(const std::vector<uint8_t> &frame, const std::vector<uint8_t> &data)
+  {
+    // decoded in place, the way the reader does it
+    std::vector<uint8_t> buffer(frame);
+    size_t length = 0;
+    return CobsDecode(buffer.data(), buffer.size(), buffer.data(), &length) &&
+      std::vector<uint8_t>(buffer.begin(), buffer.begin() + length) == data;
+  }
+
+  void CobsRoundTrips()
+  {
+    const std::vector<std::vector<uint8_t>> cases = {
+      {},
+      { 0 },
+      { 0, 0, 0, 0 },
+      { 1, 0, 0, 2, 0 },
+      { 0, 1, 2, 3 },
+      std::vector<uint8_t>(253, 7),
+      std::vector<uint8_t>(254, 7),
+      std::vector<uint8_t>(255, 7),
+      std::vector<uint8_t>(508, 7),
+      std::vector<uint8_t>(1000, 0),
+    };
+    for (auto &&data : cases)
+    {
+      const auto frame = CobsEncode(data);
+      Check(std::find(frame.begin(), frame.end(), 0) == frame.end(), "no zero in a frame");
+      Check(Decodes(frame, data), "round trip");
+    }
+    // a block of 254 bytes followed by a zero
+    std::vector<uint8_t> data(254, 7);
+    data.push_back(0);
+    data.push_back(9);
+    Check(Decodes(CobsEncode(data), data), "254 bytes then zero");
+    // encoders may close a full block with an empty one
+    std::vector<uint8_t> frame(1, 0xFF);
+    frame.insert(frame.end(), 254, 7);
+    frame.push_back(1);
+    Check(Decodes(frame, std::vector<uint8_t>(254, 7)), "full block closed by an empty one");
+    std::mt19937 random(17);
+    for (int i = 0; i < 2000; ++i)
+    {
+      std::vector<uint8_t> data(random() % 700);
+      // zero runs and long stretches without zeros
+      const unsigned zeros = random() % 4 == 0 ? 2 : 200;
+      for (auto &b : data)
+      {
+        b = random() % zeros == 0 ? 0 : static_cast<uint8_t>(1 + random() % 255);
+      }
+      Check(Decodes(CobsEncode(data), data), "random round trip");
+    }
+  }
+
+  void CobsRejectsBrokenFrames()
+  {
+    std::vector<uint8_t> data(300);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      data[i] = static_cast<uint8_t>(i % 50);
+    }
+    const auto frame = CobsEncode(data);
+    uint8_t out[400];
+    size_t length = 0;
+    // cut within a block
+    Check(!CobsDecode(frame.data(), 5, out, &length), "truncated block");
+    Check(!CobsDecode(frame.data(), frame.size() - 1, out, &length), "truncated last block");
+    const uint8_t zero[] = { 3, 1, 0, 2 };
+    Check(!CobsDecode(zero, sizeof(zero), out, &length), "zero code");
+    const uint8_t past[] = { 0xFF, 1, 2 };
+    Check(!CobsDecode(past, sizeof(past), out, &length), "block past the end");
+  }
+
+  std::wstring Render(const char *format, const std::vector<uint8_t> &args, bool expectFit = true)
+  {
+    TraceFormat f(L"main.c", L"main", format);
+    std::wstring text;
+    Check(f.Render(args.data(), args.size(), &text) == expectFit, format);
+    return text;
+  }
+
+  void Renders()
+  {
+    Check(Render("plain text", {}) == L"plain text", "literal");
+    Check(Render("100%% done", {}) == L"100% done", "percent");
+    Check(Render("%d", { 0xFE, 0xFF, 0xFF, 0xFF }) == L"-2", "int");
+    Check(Render("%hd|%hhd", { 0x00, 0x80, 0xFF }) == L"-32768|-1", "short and char sign extended");
+    Check(Render("%u", { 0xFE, 0xFF, 0xFF, 0xFF }) == L"4294967294", "unsigned");
+    Check(Render("%lld", { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }) == L"-1", "long long");
+    Check(Render("%llu", { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }) == L"18446744073709551615", "unsigned long long");
+    Check(Render("0x%08x %X %o", { 0xEF, 0xBE, 0, 0, 0xAB, 0, 0, 0, 8, 0, 0, 0 }) == L"0x0000beef AB 10", "hex and octal");
+    Check(Render("%-5d|%5d|%+d", { 7, 0, 0, 0, 7, 0, 0, 0, 7, 0, 0, 0 }) == L"7    |    7|+7", "flags and width");
+    Check(Render("%p", { 0x78, 0x56, 0x34, 0x12 }) == L"0x12345678", "pointer");
+    Check(Render("%zu %lu", { 5, 0, 0, 0, 6, 0, 0, 0 }) == L"5 6", "size_t and long are 4 bytes");
+    Check(Render("%.2f", { 0x00, 0x00, 0xC0, 0x3F }) == L"1.50", "float");
+    Check(Render("%.3lf", { 0, 0, 0, 0, 0, 0, 0xF8, 0xBF }) == L"-1.500", "double");
+    Check(Render("%c%c", { 'o', 'k' }) == L"ok", "chars");
+    Check(Render("[%s] [%5s]", { 2, 'h', 'i', 1, 'x' }) == L"[hi] [    x]", "strings");
+    Check(Render("%s", { 3, 0xC3, 0xA4, '!' }) == L"ä!", "UTF-8 string");
+    Check(Render("gr\xC3\xBC\xC3\x9F %d", { 1, 0, 0, 0 }) == L"grüß 1", "UTF-8 literal");
+    const std::string longString(300, 'y');
+    std::vector<uint8_t> args(1, 200);
+    args.insert(args.end(), longString.begin(), longString.begin() + 200);
+    Check(Render("%s", args) == std::wstring(200, L'y'), "string longer than the render buffer");
+    Check(Render("%k %d", { 3, 0, 0, 0 }) == L"%k 3", "unknown conversion shown");
+    Check(Render("end %", {}) == L"end %", "trailing percent");
+    Check(Render("end %l", {}) == L"end %l", "unfinished conversion");
+    // arguments that do not fit
+    Render("%d", { 1, 0 }, false);
+    Render("%d", { 1, 0, 0, 0, 0 }, false);
+    Render("%s", { 5, 'a' }, false);
+    Check(Render("a=%d b=%d", { 1, 0, 0, 0 }, false) == L"a=1 b=", "rendered up to the missing argument");
+  }
+
+  std::vector<uint8_t> Record(uint16_t id, uint32_t stamp, const std::vector<uint8_t> &args)
+  {
+    std::vector<uint8_t> data = { static_cast<uint8_t>(id), static_cast<uint8_t>(id >> 8) };
+    for (int i = 0; i < 4; ++i)
+    {
+      data.push_back(static_cast<uint8_t>(stamp >> i * 8));
+    }
+    data.insert(data.end(), args.begin(), args.end());
+    return CobsEncode(data);
+  }
+
+  bool Decode(BinaryTraceDecoder &decoder, const std::vector<uint8_t> &frame)
+  {
+    return decoder.Decode(reinterpret_cast<const char *>(frame.data()), frame.size());
+  }
+
+  void TableAndDecoder()
+  {
+    const auto path = std::filesystem::temp_directory_path() / "etrace_trace_format_test.txt";
+    {
+      std::ofstream out(path, std::ios::binary);
+      out << "# id\tfile\tfunction\tformat\r\n"
+        "1\tadc.c\tSample\tchannel %hhu: %d mV\r\n"
+        "0x10\tnet.c\tSend\tsent %u bytes\tto %s\n"
+        "\n"
+        "broken line\n"
+        "x2\ta.c\tf\tnot a number\n";
+    }
+    TraceFormatTable table;
+    Check(table.Load(path), "table loaded");
+    std::filesystem::remove(path);
+    Check(!table.IsEmpty() && table.Find(1) && table.Find(16) && !table.Find(2), "formats by id");
+    Check(table.Find(1)->File() == L"adc.c" && table.Find(1)->Function() == L"Sample", "file and function");
+    Check(!TraceFormatTable().Load(path), "missing table");
+
+    BinaryTraceDecoder decoder(table);
+    Check(Decode(decoder, Record(1, 0xFFFFFF00, { 3, 0x10, 0x27, 0, 0 })), "decoded");
+    Check(decoder.Format() == table.Find(1) && decoder.Text() == L"channel 3: 10000 mV", "text");
+    Check(decoder.Time() == 0, "first record at zero");
+    // the device counter wraps
+    Check(Decode(decoder, Record(16, 0x00000100, { 0, 1, 0, 0, 2, 'o', 'k' })), "decoded tab format");
+    Check(decoder.Text() == L"sent 256 bytes\tto ok" && decoder.Time() == 0x200, "time over the wrap");
+    Check(Decode(decoder, Record(7, 0x00000200, { 1, 2, 3 })), "unknown id decoded");
+    Check(!decoder.Format() && decoder.Text() == L"unknown format 7, 3 argument bytes", "unknown id");
+    Check(decoder.Time() == 0x300, "time of the unknown record");
+    Check(Decode(decoder, Record(1, 0x00000200, { 3 })), "short arguments decoded");
+    Check(decoder.Text() == L"channel 3:  [arguments do not match the format]", "short arguments");
+    const auto frame = Record(1, 0, { 1, 2, 3, 4, 5 });
+    Check(!decoder.Decode(reinterpret_cast<const char *>(frame.data()), frame.size() - 2), "truncated frame");
+    Check(!Decode(decoder, CobsEncode({ 1, 0, 0, 0, 0 })), "no room for the header");
+    decoder.Reset();
+    Check(Decode(decoder, Record(1, 5, { 1, 1, 0, 0, 0 })) && decoder.Time() == 0, "reset starts the time line");
+  }
+} // private namespace
+
+int main()
+{
+  CobsRoundTrips();
+  CobsRejectsBrokenFrames();
+  Renders();
+  TableAndDecoder();
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include "update_coalescer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  // One simulated second of ingestion at 1M events per second with the
+  // view taking an update on each 33 ms refresh tick, like IDT_VIEWREFRESH.
+  void LayoutPassesPerTick()
+  {
+    using namespace std::chrono;
+    const auto tick = milliseconds(33);
+    const auto eventGap = microseconds(1);
+    const size_t events = 1000000;
+    UpdateCoalescer updates;
+    // simulated time, advanced per event instead of waiting
+    microseconds now(0);
+    microseconds nextTick = tick;
+    size_t ticks = 0;
+    size_t layoutPasses = 0;
+    size_t itemCountUpdates = 0;
+    size_t shownRows = 0;
+    for (size_t i = 1; i <= events; ++i)
+    {
+      updates.RowsAdded(i);
+      // a longest text grows every few events
+      if (i % 7 == 0)
+      {
+        updates.LayoutChanged();
+      }
+      now += eventGap;
+      while (now >= nextTick)
+      {
+        ++ticks;
+        nextTick += tick;
+        UpdateCoalescer::Update update = {};
+        if (updates.Take(&update))
+        {
+          ++itemCountUpdates;
+          layoutPasses += update.layoutChanged;
+          shownRows = update.rowCount;
+        }
+      }
+    }
+    // end of the trace, EndTrace takes the rest without waiting for a tick
+    UpdateCoalescer::Update update = {};
+    if (updates.Take(&update))
+    {
+      ++itemCountUpdates;
+      layoutPasses += update.layoutChanged;
+      shownRows = update.rowCount;
+    }
+    printf("%zu events, %zu ticks, %zu item count updates, %zu layout passes\n",
+      events, ticks, itemCountUpdates, layoutPasses);
+    Check(layoutPasses <= ticks + 1, "layout passes bounded by refresh ticks");
+    Check(itemCountUpdates <= ticks + 1, "item count updates bounded by refresh ticks");
+    Check(shownRows == events, "last update has all rows");
+    Check(!updates.Take(&update), "nothing left after the final update");
+  }
+
+  void ResetForgetsEverything()
+  {
+    UpdateCoalescer updates;
+    UpdateCoalescer::Update update = {};
+    updates.RowsAdded(10);
+    updates.LayoutChanged();
+    Check(updates.Take(&update) && update.rowCount == 10 && update.layoutChanged, "first update");
+    updates.LayoutChanged();
+    updates.Reset();
+    Check(!updates.Take(&update), "no update after reset");
+    // rows counted from zero again, 10 is new after a reset
+    updates.RowsAdded(10);
+    Check(updates.Take(&update) && update.rowCount == 10 && !update.layoutChanged, "update after reset");
+  }
+
+  // Events recorded from another thread while the view takes updates.
+  void ConcurrentRecording()
+  {
+    UpdateCoalescer updates;
+    const size_t events = 2000000;
+    std::atomic<bool> done(false);
+    std::thread producer([&]()
+    {
+      for (size_t i = 1; i <= events; ++i)
+      {
+        updates.RowsAdded(i);
+        if (i % 1000 == 0)
+        {
+          updates.LayoutChanged();
+        }
+      }
+      done = true;
+    });
+    size_t takes = 0;
+    size_t lastRows = 0;
+    UpdateCoalescer::Update update = {};
+    while (!done)
+    {
+      ++takes;
+      if (updates.Take(&update))
+      {
+        Check(update.rowCount >= lastRows, "row count never goes back");
+        lastRows = update.rowCount;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    producer.join();
+    if (updates.Take(&update))
+    {
+      lastRows = update.rowCount;
+    }
+    Check(lastRows == events, "final update has all rows");
+  }
+} // private namespace
+
+int main()
+{
+  LayoutPassesPerTick();
+  ResetForgetsEverything();
+  ConcurrentRecording();
+  return 0;
+}
@@ -0,0 +1,153 @@
+#include "value_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  void Check(bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAILED: %s\n", what);
+      exit(1);
+    }
+  }
+
+  std::wstring Value(size_t n)
+  {
+    return L"value " + std::to_wstring(n);
+  }
+
+  bool Descending(const std::vector<ValueStats::Entry> &entries)
+  {
+    return std::is_sorted(entries.begin(), entries.end(), [](const ValueStats::Entry &a, const ValueStats::Entry &b)
+    {
+      return a.count > b.count;
+    });
+  }
+
+  // counts stay exact up to exactLimit distinct values, one more switches to
+  // the sketch, which starts with the topK most frequent exact counts
+  void SwitchAtExactLimit()
+  {
+    ValueStats stats(8, 4);
+    for (size_t n = 0; n < 8; ++n)
+    {
+      for (size_t i = 0; i <= n; ++i)
+      {
+        stats.Add(Value(n));
+      }
+    }
+    Check(stats.IsExact(), "exact at the limit");
+    auto top = stats.Top(100);
+    Check(top.size() == 8 && Descending(top), "all exact values");
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+      Check(top[i].value == Value(7 - i) && top[i].count == 8 - i && top[i].error == 0, "exact counts");
+    }
+    Check(stats.Top(3).size() == 3 && stats.Top(3)[0].value == Value(7), "top three");
+    stats.Add(Value(8));
+    Check(!stats.IsExact(), "sketch past the limit");
+    top = stats.Top(100);
+    Check(top.size() == 4 && Descending(top), "topK values kept");
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+      Check(top[i].value == Value(7 - i) && top[i].count == 8 - i && top[i].error == 0, "kept counts");
+    }
+    // a new value takes the place of the least frequent one and inherits its
+    // count as the error
+    stats.Add(Value(9));
+    top = stats.Top(100);
+    const auto added = std::find_if(top.begin(), top.end(), [](const ValueStats::Entry &e)
+    {
+      return e.value == Value(9);
+    });
+    Check(top.size() == 4 && added != top.end() && added->count == 6 && added->error == 5, "replaced least frequent");
+    Check(std::none_of(top.begin(), top.end(), [](const ValueStats::Entry &e) { return e.value == Value(4); }),
+      "least frequent dropped");
+    stats.Clear();
+    Check(stats.IsExact() && stats.Top(100).empty(), "cleared");
+    stats.Add(Value(1));
+    Check(stats.IsExact() && stats.Top(100).size() == 1, "exact again after clear");
+  }
+
+  // Skewed random streams. Every add lands on exactly one tracked value,
+  // which only holds while the heap slots point at the right entries, and
+  // the Space-Saving bounds hold for every tracked value.
+  void RandomStreams(unsigned seed, size_t exactLimit, size_t topK, size_t distinct, size_t adds)
+  {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    ValueStats stats(exactLimit, topK);
+    std::unordered_map<std::wstring, size_t> truth;
+    size_t sketchSum = 0;
+    size_t sketchAdds = 0;
+    for (size_t i = 0; i < adds; ++i)
+    {
+      // roughly Zipf distributed, a few values dominate
+      const auto n = static_cast<size_t>(distinct * uniform(random) * uniform(random) * uniform(random));
+      const auto value = Value(n);
+      const bool wasExact = stats.IsExact();
+      stats.Add(value);
+      ++truth[value];
+      if (wasExact && !stats.IsExact())
+      {
+        for (auto &&e : stats.Top(topK))
+        {
+          Check(e.count == truth[e.value] && e.error == 0, "exact counts carried into the sketch");
+          sketchSum += e.count;
+        }
+      }
+      else if (!wasExact)
+      {
+        ++sketchAdds;
+      }
+      if (i % (adds / 500 + 1) != 0 && i + 1 != adds)
+      {
+        continue;
+      }
+      const auto top = stats.Top(exactLimit);
+      Check(top.size() <= (stats.IsExact() ? exactLimit : topK), "entry count");
+      Check(Descending(top), "most frequent first");
+      std::set<std::wstring> values;
+      size_t sum = 0;
+      for (auto &&e : top)
+      {
+        Check(values.insert(e.value).second, "values tracked once");
+        Check(e.error <= e.count, "error within count");
+        Check(e.count - e.error <= truth[e.value], "count - error <= true count");
+        Check(truth[e.value] <= e.count, "true count <= count");
+        sum += e.count;
+      }
+      if (stats.IsExact())
+      {
+        Check(top.size() == truth.size(), "every value counted");
+        continue;
+      }
+      Check(sum == sketchSum + sketchAdds, "every add counted once");
+      // a value not tracked occurs at most as often as the least tracked one
+      for (auto &&t : truth)
+      {
+        Check(values.count(t.first) || t.second <= top.back().count, "frequent values tracked");
+      }
+    }
+    Check(!stats.IsExact(), "stream switched to the sketch");
+  }
+} // private namespace
+
+int main()
+{
+  SwitchAtExactLimit();
+  RandomStreams(1, 64, 16, 2000, 50000);
+  RandomStreams(2, 200, 100, 10000, 100000);
+  RandomStreams(3, 16, 1, 100, 5000);
+  RandomStreams(4, 0x1000, 0x100, 20000, 100000);
+  return 0;
+}